@@ -0,0 +1,266 @@
+"""
+Asynchronous service calls: acall() returns a Future that gets resolved
+when the reply arrives.
+
+Replies go to the ATMI context that made the call, and a context is
+used by one thread at a time, so the calls are made by worker threads,
+each with its own context. An idle worker takes a submitted call, issues
+it together with any others queued meanwhile (tpacall()), then blocks in
+tpgetrplyex(), i.e. tpgetrply(TPGETANY) with the GIL released, and
+resolves the futures by call descriptor as the replies come in. Calls
+submitted while all workers wait for replies start a new worker, up to
+max_workers. Callers never block on the ATMI queues and nothing polls.
+
+    import endurox.aio
+
+    client = endurox.aio.Client()
+    f = client.acall("SVC", {"T_STRING_FLD": "hello"})
+    f.add_done_callback(on_reply)
+    ...
+    data = f.result(timeout=5)
+
+For event loops (select/poll based, Twisted, Tornado, ...), register
+client.fileno() for reading and call client.completed() when it is
+readable; it returns the futures finished since the last call.
+"""
+
+import errno
+import fcntl
+import os
+import threading
+import Queue
+
+import endurox.atmi as atmi
+
+
+class CallError(Exception):
+
+    """ service call failed: tperrno, tpurcode and the reply data (TPESVCFAIL) """
+
+    def __init__(self, tperrno, tpurcode, data=None):
+        Exception.__init__(self, "tpgetrply(): tperrno %d, tpurcode %d" % (tperrno, tpurcode))
+        self.tperrno = tperrno
+        self.tpurcode = tpurcode
+        self.data = data
+
+
+class Future:
+
+    """ result of an acall(), filled in by a worker thread """
+
+    def __init__(self):
+        self._cond = threading.Condition()
+        self._done = False
+        self._result = None
+        self._exc = None
+        self._callbacks = []
+        self.tpurcode = 0
+
+    def done(self):
+        return self._done
+
+    def result(self, timeout=None):
+        self._wait(timeout)
+        if self._exc is not None:
+            raise self._exc
+        return self._result
+
+    def exception(self, timeout=None):
+        self._wait(timeout)
+        return self._exc
+
+    def add_done_callback(self, fn):
+        self._cond.acquire()
+        try:
+            if not self._done:
+                self._callbacks.append(fn)
+                return
+        finally:
+            self._cond.release()
+        fn(self)
+
+    def _wait(self, timeout):
+        self._cond.acquire()
+        try:
+            if not self._done:
+                self._cond.wait(timeout)
+            if not self._done:
+                raise RuntimeError("timeout waiting for reply")
+        finally:
+            self._cond.release()
+
+    def _set(self, result, exc):
+        self._cond.acquire()
+        try:
+            self._result = result
+            self._exc = exc
+            self._done = True
+            self._cond.notifyAll()
+            callbacks, self._callbacks = self._callbacks, []
+        finally:
+            self._cond.release()
+        for fn in callbacks:
+            try:
+                fn(self)
+            except:
+                atmi.userlog("aio: exception in done callback")
+
+
+class Client:
+
+    """ worker threads issuing tpacall() and dispatching the replies """
+
+    def __init__(self, max_workers=16):
+        self._submit = Queue.Queue()
+        self._lock = threading.Lock()
+        self._max_workers = max_workers
+        self._workers = []
+        self._idle = 0
+        self._closed = False
+        # event loop integration, set up by fileno()
+        self._finished = None
+        self._ready_r = self._ready_w = None
+
+    def acall(self, svc, data, flags=0):
+        """ tpacall() svc, returns Future resolved with the reply data """
+        f = Future()
+        self._lock.acquire()
+        try:
+            if self._closed:
+                raise RuntimeError("aio: client closed")
+            if not self._idle and len(self._workers) < self._max_workers:
+                t = threading.Thread(target=self._run, name="endurox.aio")
+                t.setDaemon(True)
+                self._workers.append(t)
+                self._idle += 1
+                t.start()
+            self._submit.put((svc, data, flags, f))
+        finally:
+            self._lock.release()
+        return f
+
+    def fileno(self):
+        """ readable when futures were completed, see completed() """
+        self._lock.acquire()
+        try:
+            if self._ready_r is None:
+                self._finished = []
+                self._ready_r, self._ready_w = os.pipe()
+                # never block a worker if nobody drains the pipe
+                for fd in (self._ready_r, self._ready_w):
+                    fcntl.fcntl(fd, fcntl.F_SETFL, fcntl.fcntl(fd, fcntl.F_GETFL) | os.O_NONBLOCK)
+        finally:
+            self._lock.release()
+        return self._ready_r
+
+    def completed(self):
+        """ futures completed since last call, drains fileno() """
+        if self._ready_r is None:
+            return []
+        try:
+            os.read(self._ready_r, 4096)
+        except OSError:
+            pass
+        self._lock.acquire()
+        try:
+            done, self._finished = self._finished, []
+        finally:
+            self._lock.release()
+        return done
+
+    def close(self):
+        """ wait for the outstanding calls and stop the workers """
+        self._lock.acquire()
+        try:
+            self._closed = True
+            workers = list(self._workers)
+        finally:
+            self._lock.release()
+        for t in workers:
+            self._submit.put(None)
+        for t in workers:
+            t.join()
+        if self._ready_r is not None:
+            os.close(self._ready_r)
+            os.close(self._ready_w)
+
+    def _resolve(self, f, result, exc):
+        f._set(result, exc)
+        if self._ready_w is None:
+            return
+        self._lock.acquire()
+        try:
+            self._finished.append(f)
+        finally:
+            self._lock.release()
+        try:
+            os.write(self._ready_w, "x")
+        except OSError, e:
+            if e.errno != errno.EAGAIN:
+                raise
+
+    def _issue(self, item, pending):
+        svc, data, flags, f = item
+        try:
+            cd = atmi.tpacall(svc, data, flags)
+        except Exception, e:
+            self._resolve(f, None, e)
+            return
+        if not cd or cd <= 0:
+            # TPNOREPLY: nothing to wait for
+            self._resolve(f, None, None)
+            return
+        pending[cd] = f
+
+    def _collect(self, pending):
+        """ block for the replies to this worker's calls """
+        while pending:
+            try:
+                cd, data, err, urcode = atmi.tpgetrplyex()
+            except Exception, e:
+                # not bound to a call, fail everything outstanding
+                atmi.userlog("aio: tpgetrply failed: %s" % e)
+                for f in pending.values():
+                    self._resolve(f, None, e)
+                pending.clear()
+                return
+            f = pending.pop(cd, None)
+            if f is None:
+                continue
+            f.tpurcode = urcode
+            if err:
+                self._resolve(f, None, CallError(err, urcode, data))
+            else:
+                self._resolve(f, data, None)
+
+    def _run(self):
+        # the thread's own ATMI context is opened by the first tpacall()
+        pending = {}
+        try:
+            while True:
+                item = self._submit.get()
+                if item is None:
+                    break
+                self._lock.acquire()
+                self._idle -= 1
+                self._lock.release()
+
+                self._issue(item, pending)
+                # take along whatever was queued meanwhile
+                while True:
+                    try:
+                        item = self._submit.get_nowait()
+                    except Queue.Empty:
+                        break
+                    if item is None:
+                        self._submit.put(None)
+                        break
+                    self._issue(item, pending)
+
+                self._collect(pending)
+
+                self._lock.acquire()
+                self._idle += 1
+                self._lock.release()
+        finally:
+            atmi.tpterm()
@@ -0,0 +1,357 @@
+/*
+   This file implements reductions over all occurrences of one UBF field:
+   sum, min, max, count and mean of numeric fields, number of distinct
+   values of any field. The values are read with Bfind() into a plain C
+   array first, so the reduction loops run over contiguous numbers; no
+   Python object is made except the result.
+
+   (c) 2017 Mavimax, SIA
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atmi.h>     /* ENDUROX Header File */
+#include <ubf.h>    /* ENDUROX Header File */
+
+#include <ndebug.h>
+#include <Python.h>
+
+#include "ndrxconvert.h"
+#include "ndrxaggr.h"
+
+/*
+ * Set Python exception for failed UBF call.
+ */
+static void aggr_ubf_error(char* func, BFLDID id)
+{
+	char tmp[200] = "";
+	sprintf(tmp, "%s(%.64s): %d - %s", func, Bfname(id), Berror, Bstrerror(Berror));
+	PyErr_SetString(PyExc_RuntimeError, tmp);
+}
+
+/*
+ * Sum integer values from v[i] on, added to `acc', as Python long: the
+ * sum went over the C long range (like Python's sum() promotes).
+ */
+static PyObject* aggr_long_bigsum(long* v, BFLDOCC i, BFLDOCC n, long acc, int op)
+{
+	PyObject* sum;
+
+	if ((sum = PyLong_FromLong(acc)) == NULL)
+	{
+		return NULL;
+	}
+
+	for (; i < n; i++)
+	{
+		PyObject* item;
+		PyObject* tmp;
+
+		if ((item = PyLong_FromLong(v[i])) == NULL)
+		{
+			Py_DECREF(sum);
+			return NULL;
+		}
+		tmp = PyNumber_Add(sum, item);
+		Py_DECREF(item);
+		Py_DECREF(sum);
+		if ((sum = tmp) == NULL)
+		{
+			return NULL;
+		}
+	}
+
+	if (NDRXPY_AGGR_MEAN == op)
+	{
+		PyObject* cnt;
+		PyObject* mean;
+
+		if ((cnt = PyInt_FromLong((long)n)) == NULL)
+		{
+			Py_DECREF(sum);
+			return NULL;
+		}
+		mean = PyNumber_TrueDivide(sum, cnt);
+		Py_DECREF(cnt);
+		Py_DECREF(sum);
+		return mean;
+	}
+
+	return sum;
+}
+
+/*
+ * Reduce integer values (SHORT, INT, LONG widened to long).
+ */
+static PyObject* aggr_long(long* v, BFLDOCC n, int op)
+{
+	BFLDOCC i;
+	long acc;
+
+	if (0 == n)
+	{
+		if (NDRXPY_AGGR_SUM == op)
+		{
+			return PyInt_FromLong(0);
+		}
+		Py_RETURN_NONE;
+	}
+
+	switch (op)
+	{
+		case NDRXPY_AGGR_MIN:
+			for (acc = v[0], i = 1; i < n; i++)
+			{
+				acc = v[i] < acc ? v[i] : acc;
+			}
+			return PyInt_FromLong(acc);
+		case NDRXPY_AGGR_MAX:
+			for (acc = v[0], i = 1; i < n; i++)
+			{
+				acc = v[i] > acc ? v[i] : acc;
+			}
+			return PyInt_FromLong(acc);
+		default:
+			for (acc = 0, i = 0; i < n; i++)
+			{
+				long next;
+
+				if (__builtin_add_overflow(acc, v[i], &next))
+				{
+					return aggr_long_bigsum(v, i, n, acc, op);
+				}
+				acc = next;
+			}
+			if (NDRXPY_AGGR_MEAN == op)
+			{
+				return PyFloat_FromDouble((double)acc / (double)n);
+			}
+			return PyInt_FromLong(acc);
+	}
+}
+
+/*
+ * Reduce floating point values (FLOAT, DOUBLE widened to double).
+ */
+static PyObject* aggr_double(double* v, BFLDOCC n, int op)
+{
+	BFLDOCC i;
+	double acc;
+
+	if (0 == n)
+	{
+		if (NDRXPY_AGGR_SUM == op)
+		{
+			return PyFloat_FromDouble(0.0);
+		}
+		Py_RETURN_NONE;
+	}
+
+	switch (op)
+	{
+		case NDRXPY_AGGR_MIN:
+			for (acc = v[0], i = 1; i < n; i++)
+			{
+				acc = v[i] < acc ? v[i] : acc;
+			}
+			return PyFloat_FromDouble(acc);
+		case NDRXPY_AGGR_MAX:
+			for (acc = v[0], i = 1; i < n; i++)
+			{
+				acc = v[i] > acc ? v[i] : acc;
+			}
+			return PyFloat_FromDouble(acc);
+		default:
+			for (acc = 0, i = 0; i < n; i++)
+			{
+				acc += v[i];
+			}
+			if (NDRXPY_AGGR_MEAN == op)
+			{
+				acc /= (double)n;
+			}
+			return PyFloat_FromDouble(acc);
+	}
+}
+
+/*
+ * Count distinct values of the field. Values stay in the buffer, the
+ * set (open addressing, FNV-1a hash) holds occurrence numbers only.
+ */
+static PyObject* aggr_distinct(UBFH* ubf, BFLDID id, BFLDOCC n)
+{
+	BFLDOCC* set = NULL;
+	char** vals = NULL;
+	BFLDLEN* lens = NULL;
+	unsigned long mask = 15;
+	BFLDOCC oc, distinct = 0;
+	PyObject* ret = NULL;
+
+	while (mask < (unsigned long)n * 2)
+	{
+		mask = mask * 2 + 1;
+	}
+
+	if ((set = (BFLDOCC*)malloc((mask + 1) * sizeof(BFLDOCC))) == NULL ||
+		(vals = (char**)malloc((n + 1) * sizeof(char*))) == NULL ||
+		(lens = (BFLDLEN*)malloc((n + 1) * sizeof(BFLDLEN))) == NULL)
+	{
+		PyErr_NoMemory();
+		goto leave_func;
+	}
+	memset(set, 0xff, (mask + 1) * sizeof(BFLDOCC));
+
+	for (oc = 0; oc < n; oc++)
+	{
+		unsigned long h = 2166136261UL;
+		BFLDLEN i;
+
+		if ((vals[oc] = Bfind(ubf, id, oc, &lens[oc])) == NULL)
+		{
+			aggr_ubf_error("Bfind", id);
+			goto leave_func;
+		}
+
+		for (i = 0; i < lens[oc]; i++)
+		{
+			h = (h ^ (unsigned char)vals[oc][i]) * 16777619UL;
+		}
+
+		for (h &= mask; set[h] >= 0; h = (h + 1) & mask)
+		{
+			if (lens[set[h]] == lens[oc] && 
+				0 == memcmp(vals[set[h]], vals[oc], lens[oc]))
+			{
+				break;
+			}
+		}
+
+		if (set[h] < 0)
+		{
+			set[h] = oc;
+			distinct++;
+		}
+	}
+
+	ret = PyInt_FromLong((long)distinct);
+
+leave_func:
+	free(set);
+	free(vals);
+	free(lens);
+	return ret;
+}
+
+/*
+ * Compute the NDRXPY_AGGR_* reduction over all occurrences of the field
+ * (new reference). Numeric reductions on non-numeric fields raise
+ * TypeError; min, max and mean of no occurrences give None.
+ * Returns NULL with Python exception set on failure.
+ */
+PyObject* ubf_aggregate(UBFH* ubf, BFLDID id, int op)
+{
+	int type = Bfldtype(id);
+	BFLDOCC n, oc;
+	PyObject* ret = NULL;
+	void* v = NULL;
+
+	if ((n = Boccur(ubf, id)) < 0)
+	{
+		aggr_ubf_error("Boccur", id);
+		return NULL;
+	}
+
+	if (NDRXPY_AGGR_COUNT == op)
+	{
+		return PyInt_FromLong((long)n);
+	}
+	else if (NDRXPY_AGGR_DISTINCT == op)
+	{
+		return aggr_distinct(ubf, id, n);
+	}
+
+	if ((v = malloc((n + 1) * (sizeof(double) > sizeof(long) ? sizeof(double) : sizeof(long)))) == NULL)
+	{
+		return PyErr_NoMemory();
+	}
+
+	switch (type)
+	{
+		case BFLD_SHORT:
+		case BFLD_LONG:
+		{
+			long* lv = (long*)v;
+
+			for (oc = 0; oc < n; oc++)
+			{
+				char* p;
+
+				if ((p = Bfind(ubf, id, oc, NULL)) == NULL)
+				{
+					aggr_ubf_error("Bfind", id);
+					goto leave_func;
+				}
+
+				/* values in the buffer need not be aligned */
+				switch (type)
+				{
+					case BFLD_SHORT:
+					{
+						short s;
+						memcpy(&s, p, sizeof(s));
+						lv[oc] = s;
+						break;
+					}
+					default:
+						memcpy(&lv[oc], p, sizeof(long));
+						break;
+				}
+			}
+			ret = aggr_long(lv, n, op);
+			break;
+		}
+		case BFLD_FLOAT:
+		case BFLD_DOUBLE:
+		{
+			double* dv = (double*)v;
+
+			for (oc = 0; oc < n; oc++)
+			{
+				char* p;
+
+				if ((p = Bfind(ubf, id, oc, NULL)) == NULL)
+				{
+					aggr_ubf_error("Bfind", id);
+					goto leave_func;
+				}
+				if (BFLD_FLOAT == type)
+				{
+					float f;
+					memcpy(&f, p, sizeof(f));
+					dv[oc] = f;
+				}
+				else
+				{
+					memcpy(&dv[oc], p, sizeof(double));
+				}
+			}
+			ret = aggr_double(dv, n, op);
+			break;
+		}
+		default:
+		{
+			char tmp[200] = "";
+			sprintf(tmp, "%.64s: numeric field expected", Bfname(id));
+			PyErr_SetString(PyExc_TypeError, tmp);
+			break;
+		}
+	}
+
+leave_func:
+	free(v);
+	return ret;
+}
+
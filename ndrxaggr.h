@@ -0,0 +1,31 @@
+/*
+   This file declares the reductions over the occurrences of one UBF
+   field (atmi.ubf_sum() and friends), computed on the buffer itself.
+
+   (c) 2017 Mavimax, SIA
+
+
+*/
+
+
+#ifndef NDRXAGGR_H
+#define NDRXAGGR_H
+
+
+
+#include <ubf.h>     /* ENDUROX Header File */
+
+
+#define NDRXPY_AGGR_SUM		1
+#define NDRXPY_AGGR_MIN		2
+#define NDRXPY_AGGR_MAX		3
+#define NDRXPY_AGGR_COUNT	4
+#define NDRXPY_AGGR_MEAN	5
+#define NDRXPY_AGGR_DISTINCT	6
+
+extern PyObject* ubf_aggregate(UBFH* ubf, BFLDID id, int op);
+
+
+
+#endif /* NDRXAGGR_H */
+
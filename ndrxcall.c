@@ -0,0 +1,358 @@
+/*
+   This file implements the atmi.PreparedCall type. The service name and
+   flags are checked once when the object is made, and the object keeps a
+   request and a reply buffer for its whole life: the request buffer is
+   reset and refilled in place by each call (growing if the data does not
+   fit), the reply buffer is handed to tpcall() as is. Batch clients
+   making many calls of the same shape thus do no tpalloc()/tpfree() and
+   no service name checks per call.
+
+   (c) 2017 Mavimax, SIA
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atmi.h>     /* ENDUROX Header File */
+#include <ubf.h>    /* ENDUROX Header File */
+
+#include <ndebug.h>
+#include <Python.h>
+#include <structmember.h>
+
+#include "ndrxconvert.h"
+#include "ndrxproxy.h"
+#include "ndrxschema.h"
+#include "ndrxcall.h"
+
+/* refilling with it just resets a UBF buffer */
+static PyObject* M_emptydict = NULL;
+
+/*
+ * Make sure the request buffer holds at least `need' bytes.
+ * Returns -1 with Python exception set on failure.
+ */
+static int prepared_reserve(PreparedCallObject* self, long need)
+{
+	long size = tptypes(self->req, NULL, NULL);
+	char* buf;
+
+	if (size >= need)
+	{
+		return 0;
+	}
+
+	if (need < size * 2)
+	{
+		need = size * 2;
+	}
+
+	if ((buf = tprealloc(self->req, need)) == NULL)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "tprealloc(%ld): %d - %s", need, tperrno, tpstrerror(tperrno));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		return -1;
+	}
+	self->req = buf;
+
+	return 0;
+}
+
+/*
+ * Copy UBF buffer to the (reset) request buffer.
+ * Returns -1 with Python exception set on failure.
+ */
+static int prepared_copy_ubf(PreparedCallObject* self, UBFH* src)
+{
+	if (dict_refill_ubf((UBFH**)&self->req, M_emptydict, 1) < 0)
+	{
+		return -1;
+	}
+
+	if (Bsizeof((UBFH*)self->req) < Bused(src) &&
+		ubf_grow((UBFH**)&self->req, Bused(src) - Bsizeof((UBFH*)self->req)) < 0)
+	{
+		return -1;
+	}
+
+	if (Bcpy((UBFH*)self->req, src) < 0)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "Bcpy(): %d - %s", Berror, Bstrerror(Berror));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		return -1;
+	}
+
+	return ubf_own_ptrs((UBFH*)self->req);
+}
+
+/*
+ * Put the call data into the request buffer, `len' gets the length to
+ * pass to tpcall() (0 if the buffer type knows it).
+ * Returns -1 with Python exception set on failure.
+ */
+static int prepared_fill(PreparedCallObject* self, PyObject* data, long* len)
+{
+	*len = 0;
+
+	if (!strcmp(self->buftype, "UBF"))
+	{
+		if (PyDict_Check(data))
+		{
+			return dict_refill_ubf((UBFH**)&self->req, data, 1);
+		}
+		else if (UbfProxy_Check(data))
+		{
+			UBFH* src;
+
+			if (ubfproxy_sync(data) < 0 || (src = ubfproxy_buffer(data)) == NULL)
+			{
+				return -1;
+			}
+			return prepared_copy_ubf(self, src);
+		}
+		else if (Record_Check(data))
+		{
+			UBFH* src;
+			int ret;
+
+			if ((src = record_to_ubf(data)) == NULL)
+			{
+				return -1;
+			}
+			ret = prepared_copy_ubf(self, src);
+			ubf_tpfree((char*)src);
+			return ret;
+		}
+	}
+	else if (!strcmp(self->buftype, "STRING") || !strcmp(self->buftype, "JSON"))
+	{
+		/* atmi.JsonStr is a str too */
+		if (PyString_Check(data))
+		{
+			Py_ssize_t n = PyString_GET_SIZE(data);
+
+			if (prepared_reserve(self, (long)n + 1) < 0)
+			{
+				return -1;
+			}
+			memcpy(self->req, PyString_AS_STRING(data), n + 1);
+			return 0;
+		}
+	}
+	else if (!PyUnicode_Check(data))
+	{
+		const void* p;
+		Py_ssize_t n;
+
+		if (PyObject_AsReadBuffer(data, &p, &n) < 0)
+		{
+			return -1;
+		}
+		if (prepared_reserve(self, (long)n) < 0)
+		{
+			return -1;
+		}
+		memcpy(self->req, p, n);
+		*len = (long)n;
+		return 0;
+	}
+
+	PyErr_Format(PyExc_TypeError, "PreparedCall: bad data for %s request buffer",
+		self->buftype);
+	return -1;
+}
+
+/*
+ * call(data) -> reply, like tpcall(service, data, flags)
+ */
+static PyObject* preparedcall_call(PreparedCallObject* self, PyObject* args, PyObject* kwds)
+{
+	PyObject* data;
+	PyObject* result = NULL;
+	long inlen = 0;
+	long outlen = 0;
+	int rc;
+
+	if (!PyArg_ParseTuple(args, "O:call", &data))
+	{
+		return NULL;
+	}
+
+	if (self->busy)
+	{
+		PyErr_SetString(PyExc_RuntimeError, "PreparedCall: call in progress in another thread");
+		return NULL;
+	}
+
+	if (prepared_fill(self, data, &inlen) < 0)
+	{
+		return NULL;
+	}
+
+	/* the previous reply may have gone to an UbfProxy */
+	if (NULL == self->rply &&
+		(self->rply = tpalloc("UBF", NULL, self->size)) == NULL)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "tpalloc(): %d - %s", tperrno, tpstrerror(tperrno));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		return NULL;
+	}
+
+	NDRXPY_LOG(log_debug, "calling tpcall(%s, [%s]...) prepared", self->svc, self->buftype);
+
+	self->busy = 1;
+	Py_BEGIN_ALLOW_THREADS
+	rc = tpcall(self->svc, self->req, inlen, &self->rply, &outlen, self->flags);
+	Py_END_ALLOW_THREADS
+	self->busy = 0;
+
+	if (rc < 0)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "tpcall(): %d - %s", tperrno, tpstrerror(tperrno));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		return NULL;
+	}
+
+	result = ndrxpy_reply_to_py(&self->rply, outlen);
+
+	return result;
+}
+
+static PyObject* preparedcall_repr(PreparedCallObject* self)
+{
+	return PyString_FromFormat("PreparedCall('%s', %ld, '%s')",
+		self->svc, self->flags, self->buftype);
+}
+
+static PyObject* preparedcall_tpnew(PyTypeObject* type, PyObject* args, PyObject* kwds)
+{
+	static char *kwlist[] = {"service", "flags", "buftype", "size_hint", NULL};
+	PreparedCallObject* self;
+	char* svc;
+	long flags = 0;
+	char* buftype = "UBF";
+	long size = NDRXBUFSIZE;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|lsl:PreparedCall", kwlist,
+			&svc, &flags, &buftype, &size))
+	{
+		return NULL;
+	}
+
+	if (strlen(svc) > XATMI_SERVICE_NAME_LENGTH)
+	{
+		PyErr_SetString(PyExc_RuntimeError, "PreparedCall: Service name length too long");
+		return NULL;
+	}
+
+	if (strcmp(buftype, "UBF") && strcmp(buftype, "STRING") &&
+		strcmp(buftype, "JSON") && strcmp(buftype, "CARRAY"))
+	{
+		PyErr_Format(PyExc_ValueError, "PreparedCall: unsupported buffer type <%s>", buftype);
+		return NULL;
+	}
+
+	if (flags < 0 || size <= 0)
+	{
+		PyErr_SetString(PyExc_ValueError, "PreparedCall: Bad flags or size_hint given");
+		return NULL;
+	}
+
+	if (NULL == M_emptydict && (M_emptydict = PyDict_New()) == NULL)
+	{
+		return NULL;
+	}
+
+	if ((self = (PreparedCallObject*)type->tp_alloc(type, 0)) == NULL)
+	{
+		return NULL;
+	}
+
+	strcpy(self->svc, svc);
+	strcpy(self->buftype, buftype);
+	self->flags = flags;
+	self->size = size;
+
+	if ((self->req = tpalloc(buftype, NULL, size)) == NULL ||
+		(self->rply = tpalloc("UBF", NULL, size)) == NULL)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "tpalloc(%s, %ld): %d - %s", buftype, size, tperrno, tpstrerror(tperrno));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		Py_DECREF(self);
+		return NULL;
+	}
+
+	return (PyObject*)self;
+}
+
+static void preparedcall_dealloc(PreparedCallObject* self)
+{
+	if (self->req)
+	{
+		ubf_tpfree(self->req);
+	}
+	if (self->rply)
+	{
+		ubf_tpfree(self->rply);
+	}
+	Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyMethodDef preparedcall_methods[] = {
+	{"call",	(PyCFunction)preparedcall_call,	METH_VARARGS, "args: ({args}|'args') -> reply, tpcall() with the prepared buffers"},
+	{NULL,		NULL,				0}
+};
+
+static PyMemberDef preparedcall_members[] = {
+	{"service",	T_STRING_INPLACE, offsetof(PreparedCallObject, svc), READONLY, "service name"},
+	{"flags",	T_LONG, offsetof(PreparedCallObject, flags), READONLY, "tpcall() flags"},
+	{"buftype",	T_STRING_INPLACE, offsetof(PreparedCallObject, buftype), READONLY, "request buffer type"},
+	{NULL}
+};
+
+PyTypeObject PreparedCall_Type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"atmi.PreparedCall",			/* tp_name */
+	sizeof(PreparedCallObject),		/* tp_basicsize */
+	0,					/* tp_itemsize */
+	(destructor)preparedcall_dealloc,	/* tp_dealloc */
+	0,					/* tp_print */
+	0,					/* tp_getattr */
+	0,					/* tp_setattr */
+	0,					/* tp_compare */
+	(reprfunc)preparedcall_repr,		/* tp_repr */
+	0,					/* tp_as_number */
+	0,					/* tp_as_sequence */
+	0,					/* tp_as_mapping */
+	0,					/* tp_hash */
+	(ternaryfunc)preparedcall_call,		/* tp_call */
+	0,					/* tp_str */
+	0,					/* tp_getattro */
+	0,					/* tp_setattro */
+	0,					/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT,			/* tp_flags */
+	"PreparedCall(service, [flags], [buftype], [size_hint]): tpcall() with reused buffers",	/* tp_doc */
+	0,					/* tp_traverse */
+	0,					/* tp_clear */
+	0,					/* tp_richcompare */
+	0,					/* tp_weaklistoffset */
+	0,					/* tp_iter */
+	0,					/* tp_iternext */
+	preparedcall_methods,			/* tp_methods */
+	preparedcall_members,			/* tp_members */
+	0,					/* tp_getset */
+	0,					/* tp_base */
+	0,					/* tp_dict */
+	0,					/* tp_descr_get */
+	0,					/* tp_descr_set */
+	0,					/* tp_dictoffset */
+	0,					/* tp_init */
+	0,					/* tp_alloc */
+	preparedcall_tpnew,			/* tp_new */
+};
@@ -0,0 +1,40 @@
+/*
+   This file declares the atmi.PreparedCall type: a service call whose
+   service name, flags and request / reply buffers are set up once and
+   reused by every call.
+
+   (c) 2017 Mavimax, SIA
+
+
+*/
+
+
+#ifndef NDRXCALL_H
+#define NDRXCALL_H
+
+
+
+#include <atmi.h>     /* ENDUROX Header File */
+
+
+typedef struct {
+    PyObject_HEAD
+    char svc[XATMI_SERVICE_NAME_LENGTH+1];
+    long flags;
+    char buftype[16];   /* request buffer type: UBF, STRING, CARRAY, JSON */
+    long size;          /* size hint for (re)allocated buffers */
+    char* req;          /* request buffer, reset for each call */
+    char* rply;         /* reply buffer, NULL if handed over to a proxy */
+    int busy;           /* call in progress (buffers in use without GIL) */
+} PreparedCallObject;
+
+extern PyTypeObject PreparedCall_Type;
+
+#define PreparedCall_Check(op) PyObject_TypeCheck(op, &PreparedCall_Type)
+
+/* reply buffer to Python with the module CONV_* flags (ndrxmodule.c) */
+extern PyObject* ndrxpy_reply_to_py(char** ndrxbuf, long len);
+
+
+
+#endif /* NDRXCALL_H */
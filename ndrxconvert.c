@@ -8,6 +8,9 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 
 #include <atmi.h>     /* ENDUROX Header File */
 #include <ubf.h>    /* ENDUROX Header File */
@@ -18,360 +21,2637 @@
 #include <Python.h>
 
 #include "ndrxconvert.h"
+#include "ndrxproxy.h"
 
-PyObject* ubf_to_dict(UBFH* ubf) {
-	PyObject* result = NULL;
-	int res ;
-	char * name;
-	BFLDLEN len;
-	BFLDOCC oc;
+static int pybuffer_get(PyObject* obj, Py_buffer* view);
+
+/* conversion / dispatch logging switch (atmi.set_hotlog()) */
+int ndrxpy_hotlog = 1;
+
+/*
+ * Field name cache. Maps BFLDID to an interned Python string (open
+ * addressing table) and the interned name back to the field id (dict),
+ * so that the converters do not call Bfname()/Bfldid() or build temporary
+ * key objects for every field occurrence. Filled lazily, or preloaded from
+ * the field tables by ubf_fldcache_preload().
+ */
+
+typedef struct {
 	BFLDID id;
-	PyObject* dict, *list;
-	int type;
-	int run=0;
+	PyObject* name;		/* interned string, owned by the cache */
+} fldcache_entry;
+
+#define FLDCACHE_INITSIZE	256
+
+static fldcache_entry* M_fldcache = NULL;
+static unsigned int M_fldcache_size = 0;	/* power of 2 */
+static unsigned int M_fldcache_used = 0;
+static PyObject* M_fldcache_ids = NULL;		/* interned name -> id */
+
+#define FLDCACHE_HASH(id, size)	(((unsigned int)(id) * 2654435761U) & ((size) - 1))
+
+/*
+ * Insert entry into the id table, table must have a free slot
+ */
+static void fldcache_put(fldcache_entry* tab, unsigned int size,
+		BFLDID id, PyObject* name)
+{
+	unsigned int i = FLDCACHE_HASH(id, size);
+
+	while (tab[i].name)
+	{
+		i = (i + 1) & (size - 1);
+	}
+	tab[i].id = id;
+	tab[i].name = name;
+}
+
+/*
+ * Grow the id table so that it stays at most half full
+ */
+static int fldcache_grow(void)
+{
+	unsigned int i;
+	unsigned int size = M_fldcache_size ? M_fldcache_size * 2 : FLDCACHE_INITSIZE;
+	fldcache_entry* tab;
+
+	if ((tab = (fldcache_entry*)PyMem_Malloc(size * sizeof(*tab))) == NULL)
+	{
+		PyErr_NoMemory();
+		return -1;
+	}
+	memset(tab, 0, size * sizeof(*tab));
+
+	for (i = 0; i < M_fldcache_size; i++)
+	{
+		if (M_fldcache[i].name)
+		{
+			fldcache_put(tab, size, M_fldcache[i].id, M_fldcache[i].name);
+		}
+	}
+
+	PyMem_Free(M_fldcache);
+	M_fldcache = tab;
+	M_fldcache_size = size;
+
+	return 0;
+}
+
+/*
+ * Add id <-> name pair to the cache. Returns borrowed reference to the
+ * interned name or NULL with Python exception set.
+ */
+static PyObject* fldcache_add(BFLDID id, char* cname)
+{
+	PyObject* name = NULL;
+	PyObject* pyid = NULL;
+
+	if (NULL == M_fldcache_ids && NULL == (M_fldcache_ids = PyDict_New()))
+	{
+		return NULL;
+	}
+
+	if ((M_fldcache_used + 1) * 2 > M_fldcache_size && fldcache_grow() < 0)
+	{
+		return NULL;
+	}
+
+	if ((name = PyString_InternFromString(cname)) == NULL)
+	{
+		return NULL;
+	}
+
+	if ((pyid = PyInt_FromLong((long)id)) == NULL ||
+		PyDict_SetItem(M_fldcache_ids, name, pyid) < 0)
+	{
+		Py_XDECREF(pyid);
+		Py_DECREF(name);
+		return NULL;
+	}
+	Py_DECREF(pyid);
+
+	/* reference of name now owned by the id table */
+	fldcache_put(M_fldcache, M_fldcache_size, id, name);
+	M_fldcache_used++;
+
+	return name;
+}
+
+/*
+ * Resolve field id to interned field name (borrowed reference).
+ * Returns NULL with Python exception set if field is not known.
+ */
+PyObject* ubf_fldname(BFLDID id)
+{
+	char* cname;
+
+	if (M_fldcache_size)
+	{
+		unsigned int i = FLDCACHE_HASH(id, M_fldcache_size);
+
+		while (M_fldcache[i].name)
+		{
+			if (M_fldcache[i].id == id)
+			{
+				return M_fldcache[i].name;
+			}
+			i = (i + 1) & (M_fldcache_size - 1);
+		}
+	}
+
+	if ((cname = Bfname(id)) == NULL)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "Bfname(%ld): %d - %s", (long)id, Berror, Bstrerror(Berror));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		return NULL;
+	}
+
+	return fldcache_add(id, cname);
+}
+
+/*
+ * Resolve Python field name to field id. Returns BBADFLDID with
+ * Python exception set if key is not a string or not a known field.
+ */
+BFLDID ubf_fldid(PyObject* key)
+{
+	PyObject* pyid;
+	char* cname;
+	BFLDID id;
+
+	if (M_fldcache_ids && (pyid = PyDict_GetItem(M_fldcache_ids, key)) != NULL)
+	{
+		return (BFLDID)PyInt_AS_LONG(pyid);
+	}
+
+	if ((cname = PyString_AsString(key)) == NULL)
+	{
+		return BBADFLDID;
+	}
+
+	if ((id = Bfldid(cname)) == BBADFLDID)
+	{
+		char tmp[1024] = "";
+		sprintf(tmp, "Bfldid(%.256s): %d - %s", cname, Berror, Bstrerror(Berror));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		return BBADFLDID;
+	}
+
+	/* Bfname() gives the canonical name, the key may be some other alias */
+	if (ubf_fldname(id) == NULL)
+	{
+		return BBADFLDID;
+	}
+
+	/* the alias is resolved from the cache next time too */
+	if (PyDict_GetItem(M_fldcache_ids, key) == NULL)
+	{
+		PyObject* alias_id;
+
+		if ((alias_id = PyInt_FromLong((long)id)) == NULL ||
+			PyDict_SetItem(M_fldcache_ids, key, alias_id) < 0)
+		{
+			Py_XDECREF(alias_id);
+			return BBADFLDID;
+		}
+		Py_DECREF(alias_id);
+	}
+
+	return id;
+}
+
+/*
+ * Preload the field name cache from the field tables listed in
+ * FIELDTBLS / FLDTBLDIR. Returns number of fields loaded or -1 with
+ * Python exception set.
+ */
+int ubf_fldcache_preload(void)
+{
+	char tables[PATH_MAX] = "";
+	char dirs[PATH_MAX] = "";
+	char* env;
+	char* tab_save = NULL;
+	char* table;
+	int loaded = 0;
+
+	if (NULL == (env = getenv("FIELDTBLS")) && NULL == (env = getenv("FIELDTBLS32")))
+	{
+		return 0;
+	}
+	strncpy(tables, env, sizeof(tables)-1);
+
+	if (NULL == (env = getenv("FLDTBLDIR")) && NULL == (env = getenv("FLDTBLDIR32")))
+	{
+		env = ".";
+	}
+	strncpy(dirs, env, sizeof(dirs)-1);
+
+	for (table = strtok_r(tables, ",", &tab_save); NULL != table;
+		table = strtok_r(NULL, ",", &tab_save))
+	{
+		char dirs_tmp[PATH_MAX];
+		char* dir_save = NULL;
+		char* dir;
+		FILE* f = NULL;
+
+		strcpy(dirs_tmp, dirs);
+
+		for (dir = strtok_r(dirs_tmp, ":", &dir_save); NULL != dir && NULL == f;
+			dir = strtok_r(NULL, ":", &dir_save))
+		{
+			char path[PATH_MAX];
+			snprintf(path, sizeof(path), "%s/%s", dir, table);
+			f = fopen(path, "r");
+		}
+
+		if (NULL == f)
+		{
+			NDRX_LOG(log_warn, "fldcache: field table [%s] not found", table);
+			continue;
+		}
+
+		while (1)
+		{
+			char line[1024];
+			char cname[256];
+			BFLDID id;
+
+			if (NULL == fgets(line, sizeof(line), f))
+			{
+				break;
+			}
+
+			/* skip comments, "$" C header lines, "*base" directives */
+			if (1 != sscanf(line, "%255s", cname) ||
+				'#' == cname[0] || '$' == cname[0] || '*' == cname[0])
+			{
+				continue;
+			}
+
+			if ((id = Bfldid(cname)) == BBADFLDID)
+			{
+				continue;
+			}
+
+			if (ubf_fldname(id) == NULL)
+			{
+				fclose(f);
+				return -1;
+			}
+			loaded++;
+		}
+		fclose(f);
+	}
+
+	NDRX_LOG(log_debug, "fldcache: %d fields preloaded", loaded);
+
+	return loaded;
+}
+
+/*
+ * Convert C value of the UBF type to Python object (new reference).
+ * `len' is used for CARRAY only.
+ */
+static PyObject* cvalue_to_py(int type, char* buf, BFLDLEN len)
+{
+	switch (type)
+	{
+		case BFLD_SHORT:
+			return PyInt_FromLong(*(short*)buf);
+		case BFLD_LONG:
+			return PyInt_FromLong(*(long*)buf);
+		case BFLD_INT:
+			return PyInt_FromLong(*(int*)buf);
+		case BFLD_CHAR:
+			return Py_BuildValue("b", *buf);
+		case BFLD_FLOAT:
+			return PyFloat_FromDouble(*(float*)buf);
+		case BFLD_DOUBLE:
+			return PyFloat_FromDouble(*(double*)buf);
+		case BFLD_STRING:
+			return PyString_FromString(buf);
+		case BFLD_CARRAY:
+			return PyString_FromStringAndSize(buf, (Py_ssize_t)len);
+	}
+
+	PyErr_Format(PyExc_RuntimeError, "unsupported UBF type <%d>", type);
+	return NULL;
+}
+
+/*
+ * VIEW plans. The field list of a view (Bvnext()) is read once per view
+ * and kept with the interned dictionary keys and the C types the values
+ * are read/written as, so converting a VIEW is a walk over the plan.
+ * The struct offsets are private to libubf, values still go through
+ * CBvget()/CBvchg().
+ */
+
+typedef struct {
+	char cname[NDRX_VIEW_CNAME_LEN+1];
+	PyObject* key;		/* interned cname */
+	int fldtype;		/* field type in the view */
+	int usrtype;		/* type the value is converted as */
+	BFLDOCC maxocc;
+	long dim_size;
+} viewfld_plan;
+
+typedef struct view_plan {
+	struct view_plan* next;
+	char vname[NDRX_VIEW_NAME_LEN+1];
+	long size;		/* Bvsizeof() */
+	char* scratch;		/* value buffer, largest field + EOS */
+	int n;
+	viewfld_plan* f;
+} view_plan;
+
+static view_plan* M_viewplans = NULL;
+
+/*
+ * Get the plan of the view, build it at first use.
+ * Returns NULL with Python exception set on failure.
+ */
+static view_plan* view_plan_get(char* vname)
+{
+	view_plan* plan;
+	Bvnext_state_t state;
+	char cname[NDRX_VIEW_CNAME_LEN+1];
+	int fldtype;
+	BFLDOCC maxocc;
+	long dim_size;
+	long maxdim = (long)sizeof(double);
+	int ret, alloc = 0;
+
+	for (plan = M_viewplans; plan; plan = plan->next)
+	{
+		if (!strcmp(plan->vname, vname))
+		{
+			return plan;
+		}
+	}
+
+	if ((plan = (view_plan*)calloc(1, sizeof(view_plan))) == NULL)
+	{
+		PyErr_NoMemory();
+		return NULL;
+	}
+	strncpy(plan->vname, vname, NDRX_VIEW_NAME_LEN);
+
+	if ((plan->size = Bvsizeof(vname)) < 0)
+	{
+		goto err_ubf;
+	}
+
+	for (ret = Bvnext(&state, vname, cname, &fldtype, &maxocc, &dim_size); ret > 0;
+		ret = Bvnext(&state, NULL, cname, &fldtype, &maxocc, &dim_size))
+	{
+		viewfld_plan* f;
+
+		if (plan->n == alloc)
+		{
+			viewfld_plan* tmp;
+
+			alloc = alloc ? alloc * 2 : 16;
+			if ((tmp = (viewfld_plan*)realloc(plan->f, alloc * sizeof(viewfld_plan))) == NULL)
+			{
+				PyErr_NoMemory();
+				goto err;
+			}
+			plan->f = tmp;
+		}
+
+		f = &plan->f[plan->n];
+		strcpy(f->cname, cname);
+		f->fldtype = fldtype;
+		f->maxocc = maxocc;
+		f->dim_size = dim_size;
+
+		/* numbers are read in the widest type of the kind */
+		switch (fldtype)
+		{
+			case BFLD_SHORT:
+			case BFLD_INT:
+				f->usrtype = BFLD_LONG;
+				break;
+			case BFLD_FLOAT:
+				f->usrtype = BFLD_DOUBLE;
+				break;
+			default:
+				f->usrtype = fldtype;
+				break;
+		}
+
+		if ((f->key = PyString_InternFromString(cname)) == NULL)
+		{
+			goto err;
+		}
+		plan->n++;
+
+		if (dim_size > maxdim)
+		{
+			maxdim = dim_size;
+		}
+	}
+
+	if (ret < 0)
+	{
+		goto err_ubf;
+	}
+
+	if ((plan->scratch = (char*)malloc(maxdim + 1)) == NULL)
+	{
+		PyErr_NoMemory();
+		goto err;
+	}
+
+	NDRX_LOG(log_debug, "VIEW %s: plan of %d fields", vname, plan->n);
+
+	plan->next = M_viewplans;
+	M_viewplans = plan;
+
+	return plan;
+
+err_ubf:
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "VIEW %.64s: %d - %s", vname, Berror, Bstrerror(Berror));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+	}
+err:
+	while (plan->n > 0)
+	{
+		plan->n--;
+		Py_XDECREF(plan->f[plan->n].key);
+	}
+	free(plan->f);
+	free(plan);
+	return NULL;
+}
+
+/*
+ * Convert VIEW structure to {"vname": name, "data": {cname: occurrences}}
+ * (new reference). Occurrences follow the count fields of the view;
+ * CONV_SCALAR in flags gives single occurrences as plain values.
+ * Returns NULL with Python exception set on failure.
+ */
+PyObject* view_to_py(char* vname, char* cstruct, long flags)
+{
+	view_plan* plan;
+	PyObject* data = NULL;
+	PyObject* result = NULL;
+	int i;
+
+	if ((plan = view_plan_get(vname)) == NULL ||
+		(data = PyDict_New()) == NULL)
+	{
+		goto leave_func;
+	}
+
+	for (i = 0; i < plan->n; i++)
+	{
+		viewfld_plan* f = &plan->f[i];
+		BFLDOCC count, realocc, oc, maxocc;
+		long dim_size;
+		int fldtype;
+		PyObject* pyval;
+		PyObject* list = NULL;
+
+		if ((count = Bvoccur(cstruct, vname, f->cname, &maxocc, &realocc, 
+			&dim_size, &fldtype)) < 0)
+		{
+			goto err_ubf;
+		}
+
+		if (!(1 == count && (flags & NDRXPY_CONV_SCALAR)) &&
+			((list = PyList_New(count)) == NULL ||
+			PyDict_SetItem(data, f->key, list) < 0))
+		{
+			Py_XDECREF(list);
+			goto leave_func;
+		}
+		Py_XDECREF(list);  /* reference now owned by dictionary */
+
+		for (oc = 0; oc < count; oc++)
+		{
+			BFLDLEN len = (BFLDLEN)f->dim_size + 1;
+
+			if (CBvget(cstruct, vname, f->cname, oc, plan->scratch, &len, f->usrtype, 0) < 0)
+			{
+				goto err_ubf;
+			}
+
+			if ((pyval = cvalue_to_py(f->usrtype, plan->scratch, len)) == NULL)
+			{
+				goto leave_func;
+			}
+
+			if (NULL == list)
+			{
+				int ret = PyDict_SetItem(data, f->key, pyval);
+
+				Py_DECREF(pyval);
+				if (ret < 0)
+				{
+					goto leave_func;
+				}
+			}
+			else
+			{
+				PyList_SET_ITEM(list, oc, pyval);  /* reference now owned by list */
+			}
+		}
+	}
+
+	result = Py_BuildValue("{s:s,s:O}", "vname", vname, "data", data);
+	goto leave_func;
+
+err_ubf:
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "VIEW %.64s: %d - %s", vname, Berror, Bstrerror(Berror));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+	}
+leave_func:
+	Py_XDECREF(data);
+	return result;
+}
+
+/*
+ * Store Python value to VIEW field occurrence, converted by libubf to
+ * the field type.
+ */
+static int py_to_view_field(char* cstruct, char* vname, viewfld_plan* f, 
+	BFLDOCC oc, PyObject* pyvalue)
+{
+	PyObject* tmpobj = NULL;
+	Py_buffer view;
+	int ret = -1;
+	union {
+		long longval;
+		double doubleval;
+	} val;
+
+	view.obj = NULL;
+
+	if (PyString_Check(pyvalue))
+	{
+		ret = CBvchg(cstruct, vname, f->cname, oc, PyString_AS_STRING(pyvalue),
+			(BFLDLEN)PyString_GET_SIZE(pyvalue),
+			BFLD_CARRAY == f->fldtype ? BFLD_CARRAY : BFLD_STRING);
+	}
+	else if (PyFloat_Check(pyvalue))
+	{
+		val.doubleval = PyFloat_AS_DOUBLE(pyvalue);
+		ret = CBvchg(cstruct, vname, f->cname, oc, (char*)&val, 0, BFLD_DOUBLE);
+	}
+	else if (PyInt_Check(pyvalue) || PyLong_Check(pyvalue))
+	{
+		val.longval = PyInt_AsLong(pyvalue);
+
+		if (-1 == val.longval && PyErr_Occurred())
+		{
+			return -1;
+		}
+		ret = CBvchg(cstruct, vname, f->cname, oc, (char*)&val, 0, BFLD_LONG);
+	}
+	else if (BFLD_CARRAY == f->fldtype && pybuffer_get(pyvalue, &view) == 0)
+	{
+		ret = CBvchg(cstruct, vname, f->cname, oc, (char*)view.buf,
+			(BFLDLEN)view.len, BFLD_CARRAY);
+		PyBuffer_Release(&view);
+	}
+	else
+	{
+		PyErr_Clear();
+		if ((tmpobj = PyObject_Str(pyvalue)) == NULL)
+		{
+			return -1;
+		}
+		ret = CBvchg(cstruct, vname, f->cname, oc, PyString_AS_STRING(tmpobj), 0, BFLD_STRING);
+		Py_DECREF(tmpobj);
+	}
+
+	if (ret < 0)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "CBvchg(%.64s.%.64s, %d): %d - %s", vname, f->cname, (int)oc,
+			Berror, Bstrerror(Berror));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Fill VIEW structure from {cname: occurrences} dictionary. The structure
+ * is initialized first, fields not in the dictionary keep NULL values.
+ * Returns -1 with Python exception set on failure.
+ */
+int py_to_view(char* vname, char* cstruct, PyObject* data)
+{
+	view_plan* plan;
+	Py_ssize_t found = 0;
+	int i;
+
+	if ((plan = view_plan_get(vname)) == NULL)
+	{
+		return -1;
+	}
+
+	if (Bvsinit(cstruct, vname) < 0)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "Bvsinit(%.64s): %d - %s", vname, Berror, Bstrerror(Berror));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		return -1;
+	}
+
+	for (i = 0; i < plan->n; i++)
+	{
+		viewfld_plan* f = &plan->f[i];
+		PyObject* vallist;
+		Py_ssize_t j, n = 1;
+		PyObject** items;
+
+		if ((vallist = PyDict_GetItem(data, f->key)) == NULL)
+		{
+			continue;
+		}
+		found++;
+		items = &vallist;
+
+		if (PyList_Check(vallist) || PyTuple_Check(vallist))
+		{
+			n = PySequence_Fast_GET_SIZE(vallist);
+			items = PySequence_Fast_ITEMS(vallist);
+		}
+
+		for (j = 0; j < n; j++)
+		{
+			if (py_to_view_field(cstruct, vname, f, (BFLDOCC)j, items[j]) < 0)
+			{
+				return -1;
+			}
+		}
+
+		/* count field (if the view has one) */
+		if (Bvsetoccur(cstruct, vname, f->cname, (BFLDOCC)n) < 0)
+		{
+			char tmp[200] = "";
+			sprintf(tmp, "Bvsetoccur(%.64s.%.64s): %d - %s", vname, f->cname,
+				Berror, Bstrerror(Berror));
+			PyErr_SetString(PyExc_RuntimeError, tmp);
+			return -1;
+		}
+	}
+
+	if (found != PyDict_Size(data))
+	{
+		PyErr_Format(PyExc_KeyError, "VIEW %s: unknown field given", vname);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Check for {"vname": name, "data": {cname: occurrences}}, return the
+ * view name and data (borrowed) or NULL.
+ */
+static char* py_viewdict(PyObject* pyvalue, PyObject** data)
+{
+	PyObject* vname_py;
+
+	if (!PyDict_Check(pyvalue) || PyDict_Size(pyvalue) != 2 ||
+		(vname_py = PyDict_GetItemString(pyvalue, "vname")) == NULL ||
+		!PyString_Check(vname_py) ||
+		(*data = PyDict_GetItemString(pyvalue, "data")) == NULL ||
+		!PyDict_Check(*data))
+	{
+		return NULL;
+	}
+
+	return PyString_AS_STRING(vname_py);
+}
+
+/*
+ * Is the object a VIEW value ({"vname": name, "data": {...}}).
+ */
+int py_is_view(PyObject* pyvalue)
+{
+	PyObject* data;
+
+	return NULL != py_viewdict(pyvalue, &data);
+}
+
+/*
+ * Allocate and fill VIEW structure from {"vname": name, "data": {...}},
+ * *vname receives the view name (owned by the dictionary). Free the
+ * result with PyMem_Free().
+ * Returns NULL with Python exception set on failure.
+ */
+static char* py_to_viewfld(PyObject* pyvalue, char** vname)
+{
+	PyObject* data;
+	view_plan* plan;
+	char* cstruct;
+
+	if ((*vname = py_viewdict(pyvalue, &data)) == NULL)
+	{
+		PyErr_SetString(PyExc_TypeError, "VIEW value must be {'vname': name, 'data': {fields}}");
+		return NULL;
+	}
+
+	if ((plan = view_plan_get(*vname)) == NULL)
+	{
+		return NULL;
+	}
+
+	if ((cstruct = PyMem_Malloc(plan->size ? plan->size : 1)) == NULL)
+	{
+		PyErr_NoMemory();
+		return NULL;
+	}
+
+	if (py_to_view(*vname, cstruct, data) < 0)
+	{
+		PyMem_Free(cstruct);
+		return NULL;
+	}
+
+	return cstruct;
+}
+
+/*
+ * Make VIEW typed buffer from {"vname": name, "data": {...}}, *len gets
+ * the structure size for the ATMI call.
+ * Returns NULL with Python exception set on failure.
+ */
+char* py_to_viewbuf(PyObject* pyvalue, long* len)
+{
+	PyObject* data;
+	view_plan* plan;
+	char* vname;
+	char* buf;
+
+	if ((vname = py_viewdict(pyvalue, &data)) == NULL)
+	{
+		PyErr_SetString(PyExc_TypeError, "VIEW value must be {'vname': name, 'data': {fields}}");
+		return NULL;
+	}
+
+	if ((plan = view_plan_get(vname)) == NULL)
+	{
+		return NULL;
+	}
+
+	if ((buf = tpalloc("VIEW", vname, plan->size)) == NULL)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "tpalloc(VIEW, %.64s): %d - %s", vname, tperrno, tpstrerror(tperrno));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		return NULL;
+	}
+
+	if (py_to_view(vname, buf, data) < 0)
+	{
+		tpfree(buf);
+		return NULL;
+	}
+	*len = plan->size;
+
+	return buf;
+}
+
+/*
+ * Convert the typed buffer a BFLD_PTR field points to (new reference).
+ */
+static PyObject* ptr_to_py(char* ptr, long flags)
+{
+	char buffer_type[16] = "";
+	char buffer_subtype[NDRX_VIEW_NAME_LEN+1] = "";
+	long size;
+
+	if (NULL == ptr)
+	{
+		Py_RETURN_NONE;
+	}
+
+	if ((size = tptypes(ptr, buffer_type, buffer_subtype)) < 0)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "tptypes(): %d - %s", tperrno, tpstrerror(tperrno));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		return NULL;
+	}
+
+	if (!strcmp(buffer_type, "UBF"))
+	{
+		return ubf_to_dict((UBFH*)ptr, flags);
+	}
+	else if (!strcmp(buffer_type, "STRING"))
+	{
+		return string_to_pystring(ptr);
+	}
+	else if (!strcmp(buffer_type, "CARRAY"))
+	{
+		/* data length is not known here, whole buffer is given */
+		return carray_to_pybuffer(ptr, size);
+	}
+	else if (!strcmp(buffer_type, "VIEW"))
+	{
+		return view_to_py(buffer_subtype, ptr, flags);
+	}
+
+	PyErr_Format(PyExc_RuntimeError, "PTR field: unsupported buffer type <%s>", buffer_type);
+	return NULL;
+}
+
+/*
+ * Make typed buffer for a BFLD_PTR field from Python value.
+ * Returns NULL with Python exception set on failure.
+ */
+static char* py_to_ptr(PyObject* pyvalue)
+{
+	long len = 0;
+
+	if (PyDict_Check(pyvalue))
+	{
+		return (char*)dict_to_ubf(pyvalue);
+	}
+	else if (UbfProxy_Check(pyvalue))
+	{
+		return (char*)ubfproxy_copy(pyvalue);
+	}
+	else if (PyString_Check(pyvalue))
+	{
+		return pystring_to_string(pyvalue);
+	}
+
+	return pybuffer_to_carray(pyvalue, &len);
+}
+
+static int ubf_walk_ptrs(char* buf, int dup);
+
+/*
+ * Copy the typed buffer a BFLD_PTR field points to, with own copies of
+ * the buffers it points to in turn.
+ */
+static char* ptr_dup(char* ptr)
+{
+	char buffer_type[16] = "";
+	char buffer_subtype[NDRX_VIEW_NAME_LEN+1] = "";
+	char* copy;
+	long size;
+
+	if ((size = tptypes(ptr, buffer_type, buffer_subtype)) < 0 ||
+		(copy = tpalloc(buffer_type, buffer_subtype[0] ? buffer_subtype : NULL, size)) == NULL)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "PTR copy: %d - %s", tperrno, tpstrerror(tperrno));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		return NULL;
+	}
+
+	memcpy(copy, ptr, size);
+
+	if (ubf_walk_ptrs(copy, 1) < 0)
+	{
+		tpfree(copy);
+		return NULL;
+	}
+
+	return copy;
+}
+
+/*
+ * Walk BFLD_PTR fields of the UBF buffer (and of the UBF fields in it) and
+ * free the pointed buffers, or with `dup' replace the pointers with
+ * pointers to own copies (in place, the field size does not change).
+ * Buffers pointed to by a UBF buffer are owned by it: libatmi allocates
+ * them for received buffers, the converters for buffers made here. The
+ * walk only steps over the field headers (Bnext2() without values, own
+ * state, as the walks nest), the pointed buffers are touched only if
+ * there are PTR fields. `ubf' may be a UBF field inside another buffer.
+ */
+static int ubf_walk_ptrs_ubf(UBFH* ubf, int dup)
+{
+	Bnext_state_t state;
+	BFLDID id = BFIRSTFLDID;
+	BFLDOCC oc;
+
+	while (Bnext2(&state, ubf, &id, &oc, NULL, NULL, NULL) > 0)
+	{
+		BFLDLEN len = 0;
+		int type = Bfldtype(id);
+		char* p;
+
+		if ((BFLD_PTR != type && BFLD_UBF != type) ||
+			(p = Bfind(ubf, id, oc, &len)) == NULL)
+		{
+			continue;
+		}
+
+		if (BFLD_UBF == type)
+		{
+			if (ubf_walk_ptrs_ubf((UBFH*)p, dup) < 0)
+			{
+				return -1;
+			}
+		}
+		else if (NULL == *(char**)p)
+		{
+			continue;
+		}
+		else if (dup)
+		{
+			char* copy;
+
+			if ((copy = ptr_dup(*(char**)p)) == NULL)
+			{
+				return -1;
+			}
+			*(char**)p = copy;
+		}
+		else
+		{
+			ubf_walk_ptrs(*(char**)p, 0);
+			tpfree(*(char**)p);
+			*(char**)p = NULL;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * ubf_walk_ptrs_ubf() for a typed buffer, buffers other than UBF have no
+ * PTR fields.
+ */
+static int ubf_walk_ptrs(char* buf, int dup)
+{
+	char buffer_type[16] = "";
+
+	if (tptypes(buf, buffer_type, NULL) < 0 || strcmp(buffer_type, "UBF"))
+	{
+		return 0;
+	}
+
+	return ubf_walk_ptrs_ubf((UBFH*)buf, dup);
+}
+
+/*
+ * First BFLD_PTR field of the buffer or of the UBF fields in it, with a
+ * value set, BBADFLDID if there is none.
+ */
+static BFLDID ubf_find_ptr(UBFH* ubf)
+{
+	Bnext_state_t state;
+	BFLDID id = BFIRSTFLDID;
+	BFLDOCC oc;
+
+	while (Bnext2(&state, ubf, &id, &oc, NULL, NULL, NULL) > 0)
+	{
+		BFLDLEN len = 0;
+		int type = Bfldtype(id);
+		char* p;
+
+		if ((BFLD_PTR != type && BFLD_UBF != type) ||
+			(p = Bfind(ubf, id, oc, &len)) == NULL)
+		{
+			continue;
+		}
+
+		if (BFLD_UBF == type)
+		{
+			BFLDID sub;
+
+			if ((sub = ubf_find_ptr((UBFH*)p)) != BBADFLDID)
+			{
+				return sub;
+			}
+		}
+		else if (NULL != *(char**)p)
+		{
+			return id;
+		}
+	}
+
+	return BBADFLDID;
+}
+
+/*
+ * Give the buffer own copies of the buffers its PTR fields point to
+ * (after Bcpy(), so that both buffers can be freed with ubf_tpfree()).
+ * Returns -1 with Python exception set on failure.
+ */
+int ubf_own_ptrs(UBFH* ubf)
+{
+	return ubf_walk_ptrs((char*)ubf, 1);
+}
+
+/*
+ * Free the buffers the PTR fields point to, but keep the buffer itself
+ * (for reuse, see ndrxpool.c).
+ * Returns -1 with Python exception set on failure.
+ */
+int ubf_free_ptrs(char* buf)
+{
+	return ubf_walk_ptrs(buf, 0);
+}
+
+/*
+ * tpfree() the buffer together with the buffers its PTR fields point to.
+ */
+void ubf_tpfree(char* buf)
+{
+	ubf_walk_ptrs(buf, 0);
+	tpfree(buf);
+}
+
+/*
+ * Convert single field occurrence to Python object (new reference).
+ * Flags (CONV_*) apply to the nested UBF/VIEW/PTR values.
+ * Returns NULL with Python exception set on failure.
+ */
+PyObject* ubf_field_to_py(UBFH* ubf, BFLDID id, BFLDOCC oc, long flags)
+{
+	PyObject* pyval = NULL;
+	int type;
+
+	type = Bfldtype(id);
+	switch (type)
+	{
+		case BFLD_LONG:
+		{
+			long longval = 0;
+
+			if (Bget(ubf, id, oc, (char*)&longval, 0L) < 0)
+			{
+				break;
+			}
+			pyval = PyInt_FromLong(longval);
+			break;
+		}
+		case BFLD_SHORT:
+		{
+			short shortval = 0;
+
+			if (Bget(ubf, id, oc, (char*)&shortval, 0L) < 0)
+			{
+				break;
+			}
+			pyval = Py_BuildValue("h", shortval);
+			break;
+		}
+		case BFLD_CHAR:
+		{
+			char charval = 0;
+
+			if (Bget(ubf, id, oc, (char*)&charval, 0L) < 0)
+			{
+				break;
+			}
+			pyval = Py_BuildValue("b", charval);
+			break;
+		}
+		case BFLD_DOUBLE:
+		case BFLD_FLOAT:
+		{
+			double doubleval = 0.0;
+
+			if (CBget(ubf, id, oc, (char*)&doubleval, 0L, BFLD_DOUBLE) < 0)
+			{
+				break;
+			}
+			pyval = Py_BuildValue("d", doubleval);
+			break;
+		}
+		case BFLD_STRING:
+		{
+			BFLDLEN stringlen = 0;
+			char* stringval;
+
+			/* length from the buffer includes the EOS */
+			if ((stringval = Bfind(ubf, id, oc, &stringlen)) == NULL)
+			{
+				break;
+			}
+			pyval = PyString_FromStringAndSize(stringval,
+				(Py_ssize_t)(stringlen > 0 ? stringlen - 1 : 0));
+			break;
+		}
+		case BFLD_CARRAY:
+		{
+			BFLDLEN carraylen = 0;
+			char* carrayval;
+
+			/* copy straight from the buffer */
+			if ((carrayval = Bfind(ubf, id, oc, &carraylen)) == NULL)
+			{
+				break;
+			}
+			pyval = PyString_FromStringAndSize(carrayval, (Py_ssize_t)carraylen);
+			break;
+		}
+		case BFLD_UBF:
+		{
+			BFLDLEN sublen = 0;
+			char* sub;
+
+			/* embedded buffer, converted in place */
+			if ((sub = Bfind(ubf, id, oc, &sublen)) == NULL)
+			{
+				break;
+			}
+			pyval = ubf_to_dict((UBFH*)sub, flags);
+			break;
+		}
+		case BFLD_VIEW:
+		{
+			BFLDLEN vlen = 0;
+			BVIEWFLD* vf;
+
+			if ((vf = (BVIEWFLD*)Bfind(ubf, id, oc, &vlen)) == NULL)
+			{
+				break;
+			}
+			pyval = view_to_py(vf->vname, vf->data, flags);
+			break;
+		}
+		case BFLD_PTR:
+		{
+			BFLDLEN ptrlen = 0;
+			char* p;
+
+			if ((p = Bfind(ubf, id, oc, &ptrlen)) == NULL)
+			{
+				break;
+			}
+			pyval = ptr_to_py(*(char**)p, flags);
+			break;
+		}
+		default:
+		{
+			char msg[100];
+			sprintf(msg, "unsupported UBF type <%d>", type);
+			PyErr_SetString(PyExc_RuntimeError, msg);
+			NDRX_LOG(log_info, "Btype(): %s", Bstrerror(Berror));
+			return NULL;
+		}
+	}
+
+	if (NULL == pyval && !PyErr_Occurred())
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "Bget(%.64s, %d): %d - %s", Bfname(id), (int)oc,
+			Berror, Bstrerror(Berror));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+	}
+
+	return pyval;
+}
+
+/*
+ * Numeric occurrences as array.array (CONV_ARRAY): the values are copied
+ * by libubf straight into the array storage, no Python object per
+ * occurrence. Array typecodes are the C types of the field types.
+ */
+
+static PyObject* M_array_type = NULL;
+
+/*
+ * Get array.array type (borrowed), importing the module at first use.
+ * Returns NULL with Python exception set on failure.
+ */
+static PyObject* pyarray_type(void)
+{
+	if (NULL == M_array_type)
+	{
+		PyObject* mod;
+
+		if ((mod = PyImport_ImportModule("array")) == NULL)
+		{
+			return NULL;
+		}
+		M_array_type = PyObject_GetAttrString(mod, "array");
+		Py_DECREF(mod);
+	}
+
+	return M_array_type;
+}
+
+/*
+ * Array typecode of the field type, 0 if not numeric.
+ */
+static char array_typecode(int fldtype)
+{
+	switch (fldtype)
+	{
+		case BFLD_SHORT:
+			return 'h';
+		case BFLD_LONG:
+			return 'l';
+		case BFLD_FLOAT:
+			return 'f';
+		case BFLD_DOUBLE:
+			return 'd';
+		default:
+			return 0;
+	}
+}
+
+/*
+ * Read occ occurrences of the numeric field to new array.array. With
+ * `next' set, the buffer is being walked by Bnext2() with that state,
+ * positioned at occurrence 0 of the field, and the rest are taken with
+ * Bnext2() too (the walk continues after the field).
+ * Returns NULL with Python exception set on failure.
+ */
+static PyObject* ubf_field_to_array(UBFH* ubf, BFLDID id, BFLDOCC occ, Bnext_state_t* next)
+{
+	PyObject* proto;
+	PyObject* arr;
+	char* p;
+	Py_ssize_t size;
+	BFLDLEN itemsize;
+	BFLDOCC oc;
+
+	if (pyarray_type() == NULL ||
+		(proto = PyObject_CallFunction(M_array_type, "c[i]",
+			array_typecode(Bfldtype(id)), 0)) == NULL)
+	{
+		return NULL;
+	}
+
+	arr = PySequence_Repeat(proto, (Py_ssize_t)occ);
+	Py_DECREF(proto);
+
+	if (NULL == arr)
+	{
+		return NULL;
+	}
+
+	if (PyObject_AsWriteBuffer(arr, (void**)&p, &size) < 0)
+	{
+		Py_DECREF(arr);
+		return NULL;
+	}
+	itemsize = occ ? (BFLDLEN)(size / occ) : 0;
+
+	for (oc = 0; oc < occ; oc++, p += itemsize)
+	{
+		BFLDLEN len = itemsize;
+		char tmp[200] = "";
+
+		if (NULL != next && oc > 0)
+		{
+			BFLDID nid = id;
+			BFLDOCC noc;
+			int ret;
+
+			if ((ret = Bnext2(next, ubf, &nid, &noc, p, &len, NULL)) < 0)
+			{
+				sprintf(tmp, "Bnext2(%.64s, %d): %d - %s", Bfname(id), (int)oc,
+					Berror, Bstrerror(Berror));
+			}
+			else if (0 == ret)
+			{
+				sprintf(tmp, "Bnext2(%.64s): buffer ended after %d of %d occurrences",
+					Bfname(id), (int)oc, (int)occ);
+			}
+			else if (nid != id || noc != oc)
+			{
+				strcpy(tmp, "Bnext2(): unexpected occurrence order");
+			}
+		}
+		else if (Bget(ubf, id, oc, p, &len) < 0)
+		{
+			sprintf(tmp, "Bget(%.64s, %d): %d - %s", Bfname(id), (int)oc,
+				Berror, Bstrerror(Berror));
+		}
+
+		if (EXEOS != tmp[0])
+		{
+			PyErr_SetString(PyExc_RuntimeError, tmp);
+			Py_DECREF(arr);
+			return NULL;
+		}
+	}
+
+	return arr;
+}
+
+/*
+ * Convert all occurrences of the field to Python list (new reference).
+ * Returns NULL with Python exception set on failure.
+ */
+PyObject* ubf_field_to_list(UBFH* ubf, BFLDID id, long flags)
+{
+	BFLDOCC occ = Boccur(ubf, id);
+	BFLDOCC oc;
+	PyObject* list;
+
+	if (occ < 0)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "Boccur(): %d - %s", Berror, Bstrerror(Berror));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		return NULL;
+	}
+
+	if ((flags & NDRXPY_CONV_ARRAY) && array_typecode(Bfldtype(id)))
+	{
+		return ubf_field_to_array(ubf, id, occ, NULL);
+	}
+
+	if ((list = PyList_New(occ)) == NULL)
+	{
+		return NULL;
+	}
+
+	for (oc = 0; oc < occ; oc++)
+	{
+		PyObject* pyval;
+
+		if ((pyval = ubf_field_to_py(ubf, id, oc, flags)) == NULL)
+		{
+			Py_DECREF(list);
+			return NULL;
+		}
+		PyList_SET_ITEM(list, oc, pyval);
+	}
+
+	return list;
+}
+
+/*
+ * Fill the dictionary with field name -> list of occurrences. With
+ * NDRXPY_CONV_SCALAR in flags, fields having single occurrence are stored
+ * as plain values, with NDRXPY_CONV_ARRAY numeric fields as array.array.
+ * Occurrences of a field come one after another from Bnext2(), thus the
+ * list is presized from Boccur() at the first one and filled in place.
+ * The walk has its own state: UBF and PTR values decoded on the way walk
+ * their buffers too.
+ * A dictionary filled before is refilled: occurrence lists of the fields
+ * present again are reused (resized), fields not in the buffer removed.
+ * Returns -1 with Python exception set on failure.
+ */
+static int ubf_fill_dict(UBFH* ubf, PyObject* dict, long flags)
+{
+	int res ;
+	PyObject* name;
+	BFLDOCC oc;
+	BFLDOCC occ = 0;
+	BFLDID id;
+	PyObject* list = NULL;
+	int reuse = PyDict_Size(dict) > 0;
+	Py_ssize_t nfields = 0;
+	Bnext_state_t state;
+
+	NDRXPY_DUMP_UBF("ubf_to_dict enters with buffer", ubf);
+	id = BFIRSTFLDID;
+	while (1)
+	{
+		PyObject* pyval;
+
+		/* get next field id and occurence */
+		res = Bnext2(&state, ubf, &id, &oc, NULL, NULL, NULL);
+		if (res <= 0) break;
+
+		if (0 == oc)
+		{
+			if ((name = ubf_fldname(id)) == NULL ||
+				(occ = Boccur(ubf, id)) < 0)
+			{
+				if (!PyErr_Occurred())
+				{
+					char tmp[200] = "";
+					sprintf(tmp, "Boccur(): %d - %s", Berror, Bstrerror(Berror));
+					PyErr_SetString(PyExc_RuntimeError, tmp);
+				}
+				return -1;
+			}
+			list = NULL;
+			nfields++;
+
+			if ((flags & NDRXPY_CONV_ARRAY) && array_typecode(Bfldtype(id)) &&
+				!(1 == occ && (flags & NDRXPY_CONV_SCALAR)))
+			{
+				/* all occurrences read here, the walk goes on after them */
+				if ((pyval = ubf_field_to_array(ubf, id, occ, &state)) == NULL)
+				{
+					return -1;
+				}
+				res = PyDict_SetItem(dict, name, pyval);
+				Py_DECREF(pyval);  /* reference now owned by dictionary */
+				if (res < 0)
+				{
+					return -1;
+				}
+				continue;
+			}
+		}
+
+		if ((pyval = ubf_field_to_py(ubf, id, oc, flags)) == NULL)
+		{
+			return -1;
+		}
+
+		if (0 == oc)
+		{
+			if (1 == occ && (flags & NDRXPY_CONV_SCALAR))
+			{
+				res = PyDict_SetItem(dict, name, pyval);
+				Py_DECREF(pyval);  /* reference now owned by dictionary */
+				if (res < 0)
+				{
+					return -1;
+				}
+				continue;
+			}
+
+			if (reuse && (list = PyDict_GetItem(dict, name)) != NULL &&
+				PyList_CheckExact(list))
+			{
+				/* list of the previous decode, resized to occ */
+				Py_ssize_t n = PyList_GET_SIZE(list);
+
+				if (n > occ)
+				{
+					res = PyList_SetSlice(list, occ, n, NULL);
+				}
+				else for (res = 0; n < occ && 0 == res; n++)
+				{
+					res = PyList_Append(list, Py_None);
+				}
+
+				if (res < 0)
+				{
+					Py_DECREF(pyval);
+					return -1;
+				}
+			}
+			else if ((list = PyList_New(occ)) == NULL ||
+				PyDict_SetItem(dict, name, list) < 0)
+			{
+				Py_XDECREF(list);
+				Py_DECREF(pyval);
+				return -1;
+			}
+			else
+			{
+				Py_DECREF(list);  /* reference now owned by dictionary */
+			}
+		}
+
+		if (NULL == list || oc >= occ)
+		{
+			Py_DECREF(pyval);
+			PyErr_SetString(PyExc_RuntimeError, "Bnext2(): unexpected occurrence order");
+			return -1;
+		}
+		/* reference now owned by list */
+		Py_XDECREF(PyList_GET_ITEM(list, oc));
+		PyList_SET_ITEM(list, oc, pyval);
+	}
+	
+	if (res < 0)
+	{
+		PyErr_SetString(PyExc_RuntimeError, "Problems with Bnext2()");
+		NDRX_LOG(log_error, "Bnext2(): %s", Bstrerror(Berror));
+		return -1;
+	}
+
+	/* drop the fields of the previous decode not present now */
+	if (reuse && PyDict_Size(dict) != nfields)
+	{
+		PyObject* keys;
+		Py_ssize_t i;
+
+		if ((keys = PyDict_Keys(dict)) == NULL)
+		{
+			return -1;
+		}
+
+		for (i = 0; i < PyList_GET_SIZE(keys); i++)
+		{
+			PyObject* key = PyList_GET_ITEM(keys, i);
+
+			if ((id = ubf_fldid(key)) == BBADFLDID)
+			{
+				PyErr_Clear();
+			}
+			else if (Bpres(ubf, id, 0))
+			{
+				continue;
+			}
+
+			if (PyDict_DelItem(dict, key) < 0)
+			{
+				Py_DECREF(keys);
+				return -1;
+			}
+		}
+		Py_DECREF(keys);
+	}
+
+	NDRXPY_DUMP_PY("ubf_to_dict result:", dict);
+
+	return 0;
+}
+
+/*
+ * Convert UBF buffer to dictionary field name -> list of occurrences
+ * (new reference), see ubf_fill_dict() for the flags.
+ * Returns NULL with Python exception set on failure.
+ */
+PyObject* ubf_to_dict(UBFH* ubf, long flags)
+{
+	PyObject* dict;
+
+	if ((dict = PyDict_New()) == NULL)
+	{
+		return NULL;
+	}
+
+	if (ubf_fill_dict(ubf, dict, flags) < 0)
+	{
+		Py_DECREF(dict);
+		return NULL;
+	}
+
+	return dict;
+}
+
+/*
+ * Refill the dictionary from the UBF buffer, reusing what is there from
+ * the previous call (same conversion as ubf_to_dict()).
+ * Returns -1 with Python exception set on failure.
+ */
+int ubf_to_dict_into(UBFH* ubf, PyObject* dict, long flags)
+{
+	return ubf_fill_dict(ubf, dict, flags);
+}
+
+
+
+
+/*
+ * Convert only the listed fields of the UBF buffer to dictionary, the way
+ * ubf_to_dict() does (new reference). `fields' is terminated by BBADFLDID.
+ * Fields not present in the buffer are left out.
+ * Returns NULL with Python exception set on failure.
+ */
+PyObject* ubf_fields_to_dict(UBFH* ubf, BFLDID* fields, long flags)
+{
+	PyObject* dict;
+	BFLDID* p;
+
+	if ((dict = PyDict_New()) == NULL)
+	{
+		return NULL;
+	}
+
+	for (p = fields; BBADFLDID != *p; p++)
+	{
+		PyObject* name;
+		PyObject* pyval;
+		BFLDOCC occ;
+
+		if ((occ = Boccur(ubf, *p)) < 0)
+		{
+			char tmp[200] = "";
+			sprintf(tmp, "Boccur(%.64s): %d - %s", Bfname(*p), Berror, Bstrerror(Berror));
+			PyErr_SetString(PyExc_RuntimeError, tmp);
+			goto err;
+		}
+
+		if (0 == occ)
+		{
+			continue;
+		}
+
+		if ((name = ubf_fldname(*p)) == NULL)
+		{
+			goto err;
+		}
+
+		if (1 == occ && (flags & NDRXPY_CONV_SCALAR))
+		{
+			pyval = ubf_field_to_py(ubf, *p, 0, flags);
+		}
+		else
+		{
+			pyval = ubf_field_to_list(ubf, *p, flags);
+		}
+
+		if (NULL == pyval || PyDict_SetItem(dict, name, pyval) < 0)
+		{
+			Py_XDECREF(pyval);
+			goto err;
+		}
+		Py_DECREF(pyval);  /* reference now owned by dictionary */
+	}
+
+	return dict;
+err:
+	Py_DECREF(dict);
+	return NULL;
+}
+
+/*
+ * Enlarge UBF buffer so that at least `need' more bytes fit in it.
+ * The buffer is at least doubled to keep the number of reallocs low.
+ * Returns -1 with Python exception set on failure.
+ */
+int ubf_grow(UBFH** pp_ub, long need)
+{
+	long size = Bsizeof(*pp_ub);
+	long newsize = size * 2;
+	UBFH* ubf;
+
+	if (newsize < size + need + (long)Bneeded(1, 0))
+	{
+		newsize = size + need + (long)Bneeded(1, 0);
+	}
+
+	NDRXPY_LOG(log_debug, "Growing UBF buffer %p from %ld to %ld bytes",
+		*pp_ub, size, newsize);
+
+	if ((ubf = (UBFH*)tprealloc((char*)*pp_ub, newsize)) == NULL)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "tprealloc(%ld): %d - %s", newsize, tperrno, tpstrerror(tperrno));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		return -1;
+	}
+
+	*pp_ub = ubf;
+
+	return 0;
+}
+
+/*
+ * Add one dictionary value (occurrence list or single value) to the UBF
+ * size estimate, the way Bneeded() counts: number of occurrences plus
+ * the data bytes. Values whose size is not known up front count as the
+ * largest numeric type.
+ */
+void ubf_size_add(PyObject* vallist, BFLDOCC* nocc, long* datalen)
+{
+	Py_ssize_t i, n = 1;
+	PyObject** items = &vallist;
+
+	if (PyList_Check(vallist) || PyTuple_Check(vallist))
+	{
+		n = PySequence_Fast_GET_SIZE(vallist);
+		items = PySequence_Fast_ITEMS(vallist);
+	}
+	else if (NULL != M_array_type &&
+		PyObject_TypeCheck(vallist, (PyTypeObject*)M_array_type))
+	{
+		n = PySequence_Size(vallist);
+		*datalen += (long)n * (long)sizeof(double);
+		*nocc += (BFLDOCC)n;
+		return;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		if (PyString_Check(items[i]))
+		{
+			*datalen += (long)PyString_GET_SIZE(items[i]) + 1;
+		}
+		else if (PyByteArray_Check(items[i]))
+		{
+			*datalen += (long)PyByteArray_GET_SIZE(items[i]);
+		}
+		else
+		{
+			*datalen += (long)sizeof(double);
+		}
+	}
+	*nocc += (BFLDOCC)n;
+}
+
+/*
+ * Allocate and init UBF buffer sized for the estimate made with
+ * ubf_size_add(). The buffer is grown by the encoder if still short.
+ * Returns NULL with Python exception set on failure.
+ */
+UBFH* ubf_alloc(BFLDOCC nocc, long datalen)
+{
+	UBFH* ubf;
+	long size;
+
+	if ((size = Bneeded(nocc ? nocc : 1, (BFLDLEN)datalen)) < 0)
+	{
+		/* over the UBF limits, let the encoder fail on it */
+		size = NDRXBUFSIZE;
+	}
+
+	if ((ubf = (UBFH*)tpalloc("UBF", NULL, size)) == NULL)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "tpalloc(%ld): %d - %s", size, tperrno, tpstrerror(tperrno));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		return NULL;
+	}
+
+	if (Binit(ubf, size) < 0)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "Binit(): %d - %s", Berror, Bstrerror(Berror));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		tpfree((char*)ubf);
+		return NULL;
+	}
+
+	return ubf;
+}
+
+/*
+ * Get read access to the bytes of any object supporting the buffer
+ * protocol (str, bytearray, memoryview, buffer, array...). The new style
+ * interface is tried first, then the old one. Release with
+ * PyBuffer_Release().
+ * Returns -1 with Python exception set on failure.
+ */
+static int pybuffer_get(PyObject* obj, Py_buffer* view)
+{
+	const void* ptr;
+	Py_ssize_t len;
+
+	if (PyObject_CheckBuffer(obj))
+	{
+		return PyObject_GetBuffer(obj, view, PyBUF_SIMPLE);
+	}
+
+	if (PyObject_AsReadBuffer(obj, &ptr, &len) < 0)
+	{
+		return -1;
+	}
+
+	return PyBuffer_FillInfo(view, obj, (void*)ptr, len, 1, PyBUF_SIMPLE);
+}
+
+/*
+ * Check for an array of C numbers: array.array, or other buffer-protocol
+ * object with a native single number format (e.g. numpy arrays). Such
+ * value gives the field occurrences straight from its storage.
+ * Returns 1 (view, *usrtype and *itemsize filled), 0 if not such array,
+ * or -1 with Python exception set on failure.
+ */
+static int pynumarray_get(PyObject* obj, Py_buffer* view, int* usrtype,
+	Py_ssize_t* itemsize)
+{
+	PyObject* typecode = NULL;
+	const char* fmt;
+	int ret = 0;
+
+	/* plain values first, without importing or probing anything */
+	if (PyInt_Check(obj) || PyLong_Check(obj) || PyFloat_Check(obj) ||
+		PyString_Check(obj) || PyUnicode_Check(obj) || PyByteArray_Check(obj) ||
+		PyDict_Check(obj) || Py_None == obj)
+	{
+		return 0;
+	}
+
+	if (pyarray_type() == NULL)
+	{
+		return -1;
+	}
+
+	if (PyObject_TypeCheck(obj, (PyTypeObject*)M_array_type))
+	{
+		/* no new style buffer interface for arrays in Python 2 */
+		if ((typecode = PyObject_GetAttrString(obj, "typecode")) == NULL ||
+			pybuffer_get(obj, view) < 0)
+		{
+			Py_XDECREF(typecode);
+			return -1;
+		}
+		fmt = PyString_AsString(typecode);
+	}
+	else if (PyObject_CheckBuffer(obj) &&
+		PyObject_GetBuffer(obj, view, PyBUF_FORMAT|PyBUF_C_CONTIGUOUS) == 0)
+	{
+		fmt = view->format ? view->format : "B";
+		if ('@' == *fmt)
+		{
+			fmt++;
+		}
+	}
+	else
+	{
+		PyErr_Clear();
+		return 0;
+	}
+
+	if (NULL != fmt && EXEOS != fmt[0] && EXEOS == fmt[1])
+	{
+		ret = 1;
+		switch (fmt[0])
+		{
+			case 'h':
+				*usrtype = BFLD_SHORT;
+				*itemsize = sizeof(short);
+				break;
+			case 'i':
+				/* BFLD_INT is for VIEWs only, widened to long */
+				*usrtype = BFLD_LONG;
+				*itemsize = sizeof(int);
+				break;
+			case 'l':
+				*usrtype = BFLD_LONG;
+				*itemsize = sizeof(long);
+				break;
+			case 'f':
+				*usrtype = BFLD_FLOAT;
+				*itemsize = sizeof(float);
+				break;
+			case 'd':
+				*usrtype = BFLD_DOUBLE;
+				*itemsize = sizeof(double);
+				break;
+			default:
+				ret = 0;
+				break;
+		}
+	}
+
+	Py_XDECREF(typecode);
+
+	if (ret <= 0)
+	{
+		PyBuffer_Release(view);
+	}
+
+	return ret;
+}
+
+/*
+ * Store the numbers of the array as field occurrences 0..n-1, converted
+ * by libubf from the array item type (int items are widened to long
+ * first). The buffer is grown once for the whole array if short, thus
+ * *pp_ub may change.
+ * Returns -1 with Python exception set on failure.
+ */
+static int ubf_add_array(UBFH** pp_ub, BFLDID id, Py_buffer* view, int usrtype,
+	Py_ssize_t itemsize)
+{
+	BFLDOCC oc, n = (BFLDOCC)(view->len / itemsize);
+	char* p = (char*)view->buf;
+
+	for (oc = 0; oc < n; oc++, p += itemsize)
+	{
+		long wide;
+		char* data = p;
+		int ret;
+
+		if (BFLD_LONG == usrtype && sizeof(int) == itemsize)
+		{
+			wide = *(int*)p;
+			data = (char*)&wide;
+		}
+
+		while ((ret = CBchg(*pp_ub, id, oc, data, 0, usrtype)) < 0 && BNOSPACE == Berror)
+		{
+			if (ubf_grow(pp_ub, Bneeded(n - oc, (BFLDLEN)((n - oc) * sizeof(double)))) < 0)
+			{
+				return -1;
+			}
+		}
+
+		if (ret < 0)
+		{
+			char tmp[200] = "";
+			sprintf(tmp, "CBchg(%.64s, %d): %d - %s", Bfname(id), (int)oc,
+				Berror, Bstrerror(Berror));
+			PyErr_SetString(PyExc_RuntimeError, tmp);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Store Python value in the given field occurrence. The value is converted
+ * straight to the C type of the field (given by the field id, not by the
+ * Python type). Strings going to numeric fields are left to libubf to parse.
+ * If the buffer is full it is enlarged with tprealloc() and the change is
+ * retried, thus *pp_ub may change.
+ * Returns -1 with Python exception set on failure.
+ */
+static int py_to_ubf_field(UBFH** pp_ub, BFLDID id, BFLDOCC oc, PyObject* pyvalue)
+{
+	int type = Bfldtype(id);
+	int usrtype = type;
+	int ret = -1;
+	char* data = NULL;
+	BFLDLEN len = 0;
+	PyObject* tmpobj = NULL;
+	Py_buffer view;
+	UBFH* tmpubf = NULL;
+	char* tmpview = NULL;
+	char* ptrval = NULL;
+	union {
+		short shortval;
+		long longval;
+		char charval;
+		float floatval;
+		double doubleval;
+		BVIEWFLD viewval;
+	} val;
+
+	view.obj = NULL;
+
+	if (PyString_Check(pyvalue) && BFLD_STRING != type &&
+		BFLD_CARRAY != type && BFLD_CHAR != type && BFLD_PTR != type)
+	{
+		/* let libubf parse the text */
+		usrtype = BFLD_STRING;
+		data = PyString_AS_STRING(pyvalue);
+	}
+	else if (PyUnicode_Check(pyvalue) && BFLD_STRING != type &&
+		BFLD_CARRAY != type && BFLD_PTR != type)
+	{
+		/* through the text too, like str */
+		if ((tmpobj = PyObject_Str(pyvalue)) == NULL)
+		{
+			goto out;
+		}
+		usrtype = BFLD_STRING;
+		data = PyString_AS_STRING(tmpobj);
+	}
+	else switch (type)
+	{
+		case BFLD_SHORT:
+		case BFLD_LONG:
+		{
+			val.longval = PyInt_AsLong(pyvalue);
+
+			if (-1 == val.longval && PyErr_Occurred())
+			{
+				goto out;
+			}
+
+			if (BFLD_SHORT == type && (val.longval < SHRT_MIN || val.longval > SHRT_MAX))
+			{
+				PyErr_Format(PyExc_OverflowError, "field %s: value %ld out of range",
+					Bfname(id), val.longval);
+				goto out;
+			}
+
+			if (BFLD_SHORT == type)
+			{
+				val.shortval = (short)val.longval;
+			}
+			data = (char*)&val;
+			break;
+		}
+		case BFLD_CHAR:
+		{
+			if (PyString_Check(pyvalue))
+			{
+				val.charval = PyString_GET_SIZE(pyvalue) ? PyString_AS_STRING(pyvalue)[0] : EXEOS;
+			}
+			else
+			{
+				long longval = PyInt_AsLong(pyvalue);
+
+				if (-1 == longval && PyErr_Occurred())
+				{
+					goto out;
+				}
+				if (longval < SCHAR_MIN || longval > UCHAR_MAX)
+				{
+					PyErr_Format(PyExc_OverflowError, "field %s: value %ld out of range",
+						Bfname(id), longval);
+					goto out;
+				}
+				val.charval = (char)longval;
+			}
+			data = (char*)&val;
+			break;
+		}
+		case BFLD_FLOAT:
+		case BFLD_DOUBLE:
+		{
+			val.doubleval = PyFloat_AsDouble(pyvalue);
+
+			if (-1.0 == val.doubleval && PyErr_Occurred())
+			{
+				goto out;
+			}
+
+			if (BFLD_FLOAT == type)
+			{
+				val.floatval = (float)val.doubleval;
+			}
+			data = (char*)&val;
+			break;
+		}
+		case BFLD_STRING:
+		{
+			if (PyString_Check(pyvalue))
+			{
+				data = PyString_AS_STRING(pyvalue);
+			}
+			else if (PyFloat_Check(pyvalue))
+			{
+				/* full precision, formatted by libubf */
+				val.doubleval = PyFloat_AS_DOUBLE(pyvalue);
+				usrtype = BFLD_DOUBLE;
+				data = (char*)&val;
+			}
+			else if (PyInt_Check(pyvalue) || PyLong_Check(pyvalue))
+			{
+				val.longval = PyInt_AsLong(pyvalue);
+
+				if (-1 == val.longval && PyErr_Occurred())
+				{
+					goto out;
+				}
+				usrtype = BFLD_LONG;
+				data = (char*)&val;
+			}
+			else
+			{
+				if ((tmpobj = PyObject_Str(pyvalue)) == NULL)
+				{
+					goto out;
+				}
+				data = PyString_AS_STRING(tmpobj);
+			}
+			break;
+		}
+		case BFLD_CARRAY:
+		{
+			if (PyString_Check(pyvalue))
+			{
+				data = PyString_AS_STRING(pyvalue);
+				len = (BFLDLEN)PyString_GET_SIZE(pyvalue);
+			}
+			else if (pybuffer_get(pyvalue, &view) == 0)
+			{
+				/* Bchg() is the only copy */
+				data = (char*)view.buf;
+				len = (BFLDLEN)view.len;
+			}
+			else
+			{
+				PyErr_Clear();
+				PyErr_Format(PyExc_TypeError, "field %s: CARRAY value must be"
+					" a string or support the buffer protocol", Bfname(id));
+				goto out;
+			}
+			break;
+		}
+		case BFLD_UBF:
+		{
+			/* embedded buffer is copied in by Bchg() */
+			if (UbfProxy_Check(pyvalue))
+			{
+				if (ubfproxy_sync(pyvalue) < 0 ||
+					(data = (char*)ubfproxy_buffer(pyvalue)) == NULL)
+				{
+					goto out;
+				}
+			}
+			else if (PyDict_Check(pyvalue))
+			{
+				if ((tmpubf = dict_to_ubf(pyvalue)) == NULL)
+				{
+					goto out;
+				}
+				data = (char*)tmpubf;
+			}
+			else
+			{
+				PyErr_Format(PyExc_TypeError, "field %s: UBF value must be"
+					" a dictionary or UbfProxy", Bfname(id));
+				goto out;
+			}
+			/* not used by Bchg(), size for the growth below */
+			len = (BFLDLEN)Bused((UBFH*)data);
+			break;
+		}
+		case BFLD_VIEW:
+		{
+			char* vname;
+
+			memset(&val.viewval, 0, sizeof(val.viewval));
+
+			if ((tmpview = py_to_viewfld(pyvalue, &vname)) == NULL)
+			{
+				goto out;
+			}
+			strncpy(val.viewval.vname, vname, NDRX_VIEW_NAME_LEN);
+			val.viewval.data = tmpview;
+			len = (BFLDLEN)Bvsizeof(val.viewval.vname);
+			data = (char*)&val;
+			break;
+		}
+		case BFLD_PTR:
+		{
+			/* pointed buffer belongs to the UBF buffer, see ubf_tpfree() */
+			if (Py_None != pyvalue && (ptrval = py_to_ptr(pyvalue)) == NULL)
+			{
+				goto out;
+			}
+			data = (char*)&ptrval;
+			break;
+		}
+		default:
+		{
+			char msg[100];
+			sprintf(msg, "unsupported UBF type <%d>", type);
+			PyErr_SetString(PyExc_RuntimeError, msg);
+			goto out;
+		}
+	}
+
+	while ((ret = (usrtype == type ? Bchg(*pp_ub, id, oc, data, len) :
+			CBchg(*pp_ub, id, oc, data, len, usrtype))) < 0 &&
+		BNOSPACE == Berror)
+	{
+		long need = (BFLD_STRING == usrtype ? (long)strlen(data) + 1 :
+			(long)len + (long)sizeof(double));
+
+		if (ubf_grow(pp_ub, need) < 0)
+		{
+			goto out;
+		}
+	}
+
+	if (ret < 0)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "Bchg(%.64s, %d): %d - %s", Bfname(id), (int)oc,
+			Berror, Bstrerror(Berror));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		NDRX_LOG(log_error, "%s", tmp);
+	}
+	else if (BFLD_UBF == type && NULL == tmpubf)
+	{
+		/* copied from proxy buffer, which keeps its pointed buffers */
+		BFLDLEN sublen = 0;
+		char* sub;
+
+		if ((sub = Bfind(*pp_ub, id, oc, &sublen)) == NULL ||
+			ubf_walk_ptrs_ubf((UBFH*)sub, 1) < 0)
+		{
+			ret = -1;
+		}
+	}
+
+out:
+	Py_XDECREF(tmpobj);
+
+	if (NULL != view.obj)
+	{
+		PyBuffer_Release(&view);
+	}
+
+	if (NULL != tmpubf)
+	{
+		/* on success the pointed buffers moved to *pp_ub with Bchg() */
+		if (ret < 0)
+		{
+			ubf_tpfree((char*)tmpubf);
+		}
+		else
+		{
+			tpfree((char*)tmpubf);
+		}
+	}
 
-	dict = PyDict_New();
+	PyMem_Free(tmpview);
 
-	ndrx_debug_dump_UBF(log_debug, "ubf_to_dict enters with buffer", ubf);
-	id = BFIRSTFLDID;
-	while (1)
+	if (NULL != ptrval && ret < 0)
 	{
-		len = ATMI_MSG_MAX_SIZE;
+		ubf_tpfree(ptrval);
+	}
 
-		NDRX_LOG(log_info, "[run %d] vor bnext() (id = %d, oc = %d, len = %d) \n", 
-			run++, id, oc, len);
+	return ret < 0 ? -1 : 0;
+}
 
-		/* get next field id and occurence */
-		res = Bnext(ubf, &id, &oc, NULL, NULL);
-		if (res <= 0) break;
+/*
+ * Store value list (or single value for occurrence 0) of the field, which
+ * must not be present in the buffer yet (see ubf_set_field()).
+ * Returns -1 with Python exception set on failure.
+ */
+int ubf_add_field(UBFH** pp_ub, BFLDID id, PyObject* vallist)
+{
+	BFLDOCC oc;
+	int type = Bfldtype(id);
+
+	if (BFLD_CARRAY != type && BFLD_UBF != type && BFLD_VIEW != type &&
+		BFLD_PTR != type && !PyList_Check(vallist) && !PyTuple_Check(vallist))
+	{
+		Py_buffer view;
+		Py_ssize_t itemsize;
+		int usrtype;
+		int ret;
 
-		if ((name = Bfname(id)) == NULL)
+		/* array of numbers, one occurrence per item */
+		if ((ret = pynumarray_get(vallist, &view, &usrtype, &itemsize)) > 0)
 		{
-			NDRX_LOG(log_info, "Bfname(%lu): %s", (long)id, Bstrerror(Berror));
-			result = NULL;
-			goto leave_func;
+			ret = ubf_add_array(pp_ub, id, &view, usrtype, itemsize);
+			PyBuffer_Release(&view);
+			return ret;
 		}
-
-		if ((list = PyDict_GetItemString (dict, name)) == NULL)
+		else if (ret < 0)
 		{
-			/* key doesn't exist -> insert new list into dict */
-			list = PyList_New(0);
-			PyDict_SetItemString(dict, name, list);
-			Py_DECREF(list);  /* reference now owned by dictionary */
-		}     
+			return -1;
+		}
+	}
 
-		type = Bfldtype(id);
-		switch (type)
+	if (PyList_Check(vallist) || PyTuple_Check(vallist))
+	{
+		/* process all occurences (elements of the list) for this ID
+		(Field Name) */
+		for (oc = 0; oc < PySequence_Fast_GET_SIZE(vallist); oc++)
 		{
-			case BFLD_LONG:
+			/* borrowed reference */
+			PyObject* pyvalue = PySequence_Fast_GET_ITEM(vallist, oc);
+
+			/* gap in occurrences (see ubfbuffer.EasyList),
+			 * libubf fills it with the default value */
+			if (Py_None == pyvalue)
 			{
-				long longval = 0;
-				PyObject* pyval;
-				
-				Bget(ubf, id, oc, (char*)&longval, 0L);
-				pyval = Py_BuildValue("i", longval);
-				PyList_Append(list, pyval);
-				Py_DECREF(pyval);  /* reference now owned by list */
-				break;
+				continue;
 			}
-			case BFLD_SHORT:
-			{
-				short shortval = 0.0;
-				PyObject* pyval;
 
-				/* TODO: Add error handler: */
-				Bget(ubf, id, oc, (char*)&shortval, 0L);
-
-				pyval = Py_BuildValue("h", shortval);
-				PyList_Append(list, pyval);
-				Py_DECREF(pyval);  
-				break;
-			}
-			case BFLD_CHAR:
+			if (py_to_ubf_field(pp_ub, id, oc, pyvalue) < 0)
 			{
-				short charval = 0.0;
-				PyObject* pyval;
+				return -1;
+			}
+		}
+	}
+	/* single value -> occurrence 0 */
+	else if (py_to_ubf_field(pp_ub, id, 0, vallist) < 0)
+	{
+		return -1;
+	}
 
-				/* TODO: Add error handler: */
-				Bget(ubf, id, oc, (char*)&charval, 0L);
+	return 0;
+}
 
-				pyval = Py_BuildValue("b", charval);
-				PyList_Append(list, pyval);
-				Py_DECREF(pyval);  
-				break;
-			}
-			case BFLD_DOUBLE:
-			case BFLD_FLOAT:
-			{
-				double doubleval = 0.0;
-				BFLDLEN doublelen  = sizeof (BFLDLEN);
-				PyObject* pyval;
+/*
+ * Bdelall() the field; buffers pointed to by the occurrences (PTR fields,
+ * also inside UBF fields) belong to the buffer and are freed first.
+ * Missing field is not an error.
+ * Returns -1 with Python exception set on failure.
+ */
+static int ubf_delall(UBFH* ubf, BFLDID id)
+{
+	int type = Bfldtype(id);
 
-				/* TODO: Add error handler: */
-				Bget(ubf, id, oc, (char*)&doubleval, &doublelen);
+	if (BFLD_PTR == type || BFLD_UBF == type)
+	{
+		BFLDLEN len = 0;
+		BFLDOCC oc;
+		char* p;
 
-				pyval = Py_BuildValue("d", doubleval);
-				PyList_Append(list, pyval);
-				Py_DECREF(pyval);  
-				break;
-			}
-			case BFLD_STRING:
+		for (oc = 0; (p = Bfind(ubf, id, oc, &len)) != NULL; oc++)
+		{
+			if (BFLD_UBF == type)
 			{
-				PyObject* pyval;
-				BFLDLEN stringlen  = ATMI_MSG_MAX_SIZE;
-				char stringval[ATMI_MSG_MAX_SIZE];
-                                stringval[0]=EXEOS;
-				Bget(ubf, id, oc, (char*)&stringval, &stringlen);
-				pyval = Py_BuildValue("s", stringval);
-				PyList_Append(list, pyval);
-				Py_DECREF(pyval);  
-				break;
+				ubf_walk_ptrs_ubf((UBFH*)p, 0);
 			}
-			default:
+			else if (NULL != *(char**)p)
 			{
-				char msg[100];
-				sprintf(msg, "unsupported UBF type <%d>", type);
-				PyErr_SetString(PyExc_RuntimeError, msg);
-				NDRX_LOG(log_info, "Btype(): %s", Bstrerror(Berror));
-
-				result =  NULL;
-				goto leave_func;
+				ubf_walk_ptrs(*(char**)p, 0);
+				tpfree(*(char**)p);
+				*(char**)p = NULL;
 			}
 		}
-
 	}
-	
-	if (res < 0)
-	{
-		PyErr_SetString(PyExc_RuntimeError, "Problems with Bnext()");
-		NDRX_LOG(log_info, "Bnext(): %s", Bstrerror(Berror));
 
-		result =  NULL;
-		goto leave_func;
+	if (Bdelall(ubf, id) < 0 && BNOTPRES != Berror)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "Bdelall(%.64s): %d - %s", Bfname(id), Berror, Bstrerror(Berror));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		return -1;
 	}
-	result = dict;
 
-leave_func:
+	return 0;
+}
 
-	/* Print the buffer we got */
-	if (G_ndrx_debug.level>=5)
+/*
+ * Replace all occurrences of the field in an existing buffer with the
+ * given value list. The buffer is grown if needed, thus *pp_ub may change.
+ * Returns -1 with Python exception set on failure.
+ */
+int ubf_set_field(UBFH** pp_ub, BFLDID id, PyObject* vallist)
+{
+	if (ubf_delall(*pp_ub, id) < 0)
 	{
-		PyObject_Print(result, G_ndrx_debug.dbg_f_ptr, 0);
-		fprintf(G_ndrx_debug.dbg_f_ptr, "\n");
+		return -1;
 	}
 
-	return result;
+	return ubf_add_field(pp_ub, id, vallist);
 }
 
-
-
-
 /*
  * Convert dictionary to UBF
  */
 UBFH* dict_to_ubf(PyObject* dict)
 {
 	UBFH*        result = NULL;
-	int            idx, oc/* , bfldtype*/;
+	Py_ssize_t     pos = 0;
 	BFLDID        id;
 	UBFH*        ubf;
-	
-	PyObject* keylist;
+	PyObject*    key = NULL;
+	PyObject*    vallist = NULL;
+	BFLDOCC      nocc = 0;
+	long         datalen = 0;
 
-	keylist = PyDict_Keys(dict);
+	NDRXPY_DUMP_PY("dict_to_ubf converting out:", dict);
 
-	/* This will also cause G_ndrx_debug to make init... */
-	NDRX_LOG(log_info, "Into dict_to_ubf()");
+	/* sized for the dictionary, grown by py_to_ubf_field() if short */
+	while (PyDict_Next(dict, &pos, &key, &vallist))
+	{
+		ubf_size_add(vallist, &nocc, &datalen);
+	}
+
+	if ((ubf = ubf_alloc(nocc, datalen)) == NULL)
+	{
+		goto leave_func;
+	}
+	pos = 0;
+
+	/* key, vallist: borrowed references */
+	while (PyDict_Next(dict, &pos, &key, &vallist))
+	{
+		if ((id = ubf_fldid(key)) == BBADFLDID)
+		{
+			goto leave_func;
+		}
 
+		if (ubf_add_field(&ubf, id, vallist) < 0)
+		{
+			goto leave_func;
+		}
+	}
 
-	NDRX_LOG(log_debug, "Converting out: ");
+	result = ubf;
+leave_func:
+	if (!result)
+	{
+		ubf_tpfree((char*)ubf);
+	}
 
-	if (G_ndrx_debug.level>=5)
+	if (result)
 	{
-		PyObject_Print(dict, G_ndrx_debug.dbg_f_ptr, 0);
-		fprintf(G_ndrx_debug.dbg_f_ptr, "\n");
+		NDRXPY_DUMP_UBF("Result buffer", result);
 	}
 
+	return result;
+}
+
+/*
+ * Write the dictionary made by ubf_fields_to_dict() back to the buffer it
+ * came from. Listed fields missing from the dictionary are deleted, all
+ * dictionary keys are stored; other fields of the buffer stay untouched.
+ * *pp_ub may be reallocated.
+ * Returns -1 with Python exception set on failure.
+ */
+int dict_merge_ubf(UBFH** pp_ub, PyObject* dict, BFLDID* fields)
+{
+	Py_ssize_t pos = 0;
+	PyObject* key;
+	PyObject* vallist;
+	BFLDID* p;
+	BFLDID id;
 
-	if ((ubf = (UBFH*)tpalloc("UBF", NULL, NDRXBUFSIZE)) == NULL)
+	for (p = fields; BBADFLDID != *p; p++)
 	{
-		NDRX_LOG(log_info, "tpalloc(): %s", tpstrerror(tperrno));
-		goto leave_func;
+		PyObject* name;
+
+		if ((name = ubf_fldname(*p)) == NULL)
+		{
+			return -1;
+		}
+
+		if (NULL == PyDict_GetItem(dict, name) && ubf_delall(*pp_ub, *p) < 0)
+		{
+			return -1;
+		}
 	}
 
-	if (Binit(ubf, NDRXBUFSIZE) < 0)
+	while (PyDict_Next(dict, &pos, &key, &vallist))
 	{
-		NDRX_LOG(log_info, "Binit(): %s", Bstrerror(Berror));
-		goto leave_func;
+		if ((id = ubf_fldid(key)) == BBADFLDID ||
+			ubf_set_field(pp_ub, id, vallist) < 0)
+		{
+			return -1;
+		}
 	}
 
-	for (idx = 0; idx < PyList_Size(keylist); idx++)
+	NDRXPY_DUMP_UBF("Merged buffer", *pp_ub);
+
+	return 0;
+}
+
+/*
+ * Replace the whole content of an existing buffer with the dictionary:
+ * the buffer is reinitialized in place and keeps its allocation (grown if
+ * short, thus *pp_ub may change). With `owned', buffers pointed to by PTR
+ * fields are freed first.
+ * Returns -1 with Python exception set on failure.
+ */
+int dict_refill_ubf(UBFH** pp_ub, PyObject* dict, int owned)
+{
+	Py_ssize_t pos = 0;
+	PyObject* key;
+	PyObject* vallist;
+	BFLDID id;
+
+	if (owned && ubf_walk_ptrs((char*)*pp_ub, 0) < 0)
 	{
-		PyObject*    vallist = NULL;
-		PyObject*    key = NULL;
-		char*        key_cstring = NULL;
+		return -1;
+	}
 
-		key = PyList_GetItem(keylist, idx);  /* borrowed reference */
+	if (Binit(*pp_ub, Bsizeof(*pp_ub)) < 0)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "Binit(): %d - %s", Berror, Bstrerror(Berror));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		return -1;
+	}
 
-		if (!key)
+	while (PyDict_Next(dict, &pos, &key, &vallist))
+	{
+		if ((id = ubf_fldid(key)) == BBADFLDID ||
+			ubf_add_field(pp_ub, id, vallist) < 0)
 		{
-			NDRX_LOG(log_info, "PyList_GetItem(keys, %d) returned NULL\n", idx);
-			goto leave_func;
+			return -1;
 		}
+	}
+
+	return 0;
+}
+
+/*
+ * Convert list of row dictionaries to UBF buffer where row i gives
+ * occurrence i of its fields (result sets for C services). A field
+ * missing from a row, or None, leaves a gap filled by libubf with the
+ * default value.
+ * Returns NULL with Python exception set on failure.
+ */
+UBFH* rows_to_ubf(PyObject* rows)
+{
+	PyObject* seq;
+	UBFH* ubf = NULL;
+	Py_ssize_t i, n;
+	BFLDOCC nocc = 0;
+	long datalen = 0;
+
+	if ((seq = PySequence_Fast(rows, "rows_to_ubf: sequence of dictionaries expected")) == NULL)
+	{
+		return NULL;
+	}
+	n = PySequence_Fast_GET_SIZE(seq);
 
-		key_cstring = PyString_AsString(key);
-		id = Bfldid(key_cstring);
-		if (id == BBADFLDID)
+	for (i = 0; i < n; i++)
+	{
+		PyObject* row = PySequence_Fast_GET_ITEM(seq, i);
+		Py_ssize_t pos = 0;
+		PyObject* key;
+		PyObject* value;
+
+		if (!PyDict_Check(row))
 		{
-			char tmp[1024] = "";
-			sprintf(tmp, "Bfldid(): %d - %s:", Berror, Bstrerror(Berror));
-			PyErr_SetString(PyExc_RuntimeError, tmp);
-			goto leave_func;
+			PyErr_Format(PyExc_TypeError, "rows_to_ubf: row %d is not a dictionary", (int)i);
+			goto err;
 		}
 
-		/* borrowed reference */
-		vallist = PyDict_GetItemString(dict, key_cstring);
-
-		if (PyString_Check(vallist))
+		while (PyDict_Next(row, &pos, &key, &value))
 		{
-			char* cval = NULL;
+			ubf_size_add(value, &nocc, &datalen);
+		}
+	}
+
+	if ((ubf = ubf_alloc(nocc, datalen)) == NULL)
+	{
+		goto err;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		PyObject* row = PySequence_Fast_GET_ITEM(seq, i);
+		Py_ssize_t pos = 0;
+		PyObject* key;
+		PyObject* value;
+		BFLDID id;
 
-			cval = PyString_AsString(vallist);
-			if (cval == NULL)
+		while (PyDict_Next(row, &pos, &key, &value))
+		{
+			if (Py_None == value)
 			{
-				NDRX_LOG(log_info, "error in PyString_AsString()");
-				goto leave_func;
+				continue;
 			}
-			
-			if (CBchg(ubf, id, 0, cval, 0L, BFLD_STRING) < 0)
-			{
-				if (Berror == BNOSPACE)
-				{
-					/* realloc buffer */
-				}
-				NDRX_LOG(log_error, "error in Bchgs() : %s\n", 
-					 Bstrerror(Berror));
-				goto leave_func;
-			}	
-		} 
-		else
-		{
-			NDRX_LOG(log_debug,  "Not a string STRING!");
-			
-			/* process all occurences (elements of the list) for this ID
-			(Field Name) */
-			
-			for (oc = 0; oc < PyList_Size(vallist); oc++)
+
+			if ((id = ubf_fldid(key)) == BBADFLDID ||
+				py_to_ubf_field(&ubf, id, (BFLDOCC)i, value) < 0)
 			{
-				PyObject* pyvalue = NULL;
-				if (PyList_Check(vallist))
-				{
-					/* borrowed reference */
-					pyvalue = PyList_GetItem(vallist, oc);
-				}
-				if (pyvalue == NULL) continue;
+				goto err;
+			}
+		}
+	}
 
-				/* !!! type given by field id, not by Python types !!! */		
+	Py_DECREF(seq);
+	NDRXPY_DUMP_UBF("rows_to_ubf result", ubf);
 
-				/* bfldtype = Bfldtype(id); */
+	return ubf;
 
-				/* convert input to BFLD_STRING type */
+err:
+	Py_DECREF(seq);
+	if (NULL != ubf)
+	{
+		ubf_tpfree((char*)ubf);
+	}
+	return NULL;
+}
 
-				if (PyFloat_Check(pyvalue))
-				{
-					double cval = 0.0;
-					char string[255] = "";
-					
-					cval = PyFloat_AsDouble(pyvalue);
-					sprintf(string, "%f", cval);
-
-					if (CBchg(ubf, id, oc, string, 0L, BFLD_STRING) < 0)
-					{
-						NDRX_LOG(log_error, "error in Bchgs(): %s", 
-							Bstrerror(Berror));
-						goto leave_func;
-					}		    
-					continue;
-				}
-				
-				if  (PyLong_Check(pyvalue))
-				{
-					long cval = 0;
-					char string[255] = "";
-					
-					cval = PyLong_AsLong(pyvalue);
-					sprintf(string, "%ld", cval);
-					
-					if (CBchg(ubf, id, oc, string, 0L, BFLD_STRING) < 0) 
-					{
-						NDRX_LOG(log_error, "error in Bchgs(): %s", 
-							 Bstrerror(Berror));
-						goto leave_func;
-					}		    
-					continue;
-				}
-				
-				if (PyInt_Check(pyvalue))
-				{
-					long cval = 0;
-					char string[255] = "";
-
-					cval = PyInt_AsLong(pyvalue);			
-					sprintf(string, "%ld", cval);
-					
-					if (CBchg(ubf, id, oc, string, 0L, BFLD_STRING) < 0)
-					{
-						NDRX_LOG(log_error, "error in Bchgs(): %s",
-							 Bstrerror(Berror));
-						goto leave_func;
-					}		    
-					continue;
-				}
+/*
+ * Convert UBF buffer to list of row dictionaries, row i holding
+ * occurrence i of every field that has it (new reference). The buffer
+ * is walked once with Bnext2() (own state, nested values walk their
+ * buffers too).
+ * Returns NULL with Python exception set on failure.
+ */
+PyObject* ubf_to_rows(UBFH* ubf, long flags)
+{
+	PyObject* rows;
+	PyObject* name = NULL;
+	BFLDID id = BFIRSTFLDID;
+	BFLDOCC oc;
+	Bnext_state_t state;
+	int res;
 
-				if (PyString_Check(pyvalue) || 1)
-				{
-					char * cval;
-
-					cval = PyString_AsString(pyvalue);
-					if (cval == NULL)
-					{
-						goto leave_func;
-					}
-
-					if (Bchgs(ubf, id, oc, cval) < 0)
-					{
-						NDRX_LOG(log_error, "error in Bchgs(): %s", 
-							 Bstrerror(Berror));
-						goto leave_func;
-					}		    
-					continue;
-				}
+	if ((rows = PyList_New(0)) == NULL)
+	{
+		return NULL;
+	}
 
-				NDRX_LOG(log_error,
-					"could not convert value for key %s "
-					"to ubf type BFLD_STRING\n",
-					key_cstring);
-				
-				goto leave_func;
+	while ((res = Bnext2(&state, ubf, &id, &oc, NULL, NULL, NULL)) > 0)
+	{
+		PyObject* pyval;
+		PyObject* row;
+
+		if (0 == oc && (name = ubf_fldname(id)) == NULL)
+		{
+			goto err;
+		}
+
+		/* rows are added as deeper occurrences show up */
+		while (PyList_GET_SIZE(rows) <= oc)
+		{
+			if ((row = PyDict_New()) == NULL)
+			{
+				goto err;
+			}
+			res = PyList_Append(rows, row);
+			Py_DECREF(row);
+			if (res < 0)
+			{
+				goto err;
 			}
 		}
-	}
 
-	result = ubf;
-leave_func:
-	if (keylist)
-	{
-		Py_DECREF(keylist);
+		if ((pyval = ubf_field_to_py(ubf, id, oc, flags)) == NULL)
+		{
+			goto err;
+		}
+		res = PyDict_SetItem(PyList_GET_ITEM(rows, oc), name, pyval);
+		Py_DECREF(pyval);
+		if (res < 0)
+		{
+			goto err;
+		}
 	}
-	
-	if (!result)
+
+	if (res < 0)
 	{
-		tpfree((char*)ubf);
+		char tmp[200] = "";
+		sprintf(tmp, "Bnext2(): %d - %s", Berror, Bstrerror(Berror));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		goto err;
 	}
 
-	ndrx_debug_dump_UBF(log_debug, "Result buffer", result);
+	return rows;
 
-	return result;
+err:
+	Py_DECREF(rows);
+	return NULL;
 }
 
 char* pystring_to_string(PyObject* pystring)
@@ -422,6 +2702,152 @@ leave_func:
 }
 
 
+/*
+ * Copy the bytes of a buffer protocol object (bytearray, memoryview,
+ * buffer, array...) to a new CARRAY typed buffer. The data is copied
+ * once, *len receives the data length for the ATMI call.
+ * Returns NULL with Python exception set on failure.
+ */
+char* pybuffer_to_carray(PyObject* pybuf, long* len)
+{
+	char* result = NULL;
+	Py_buffer view;
+
+	if (pybuffer_get(pybuf, &view) < 0)
+	{
+		goto leave_func;
+	}
+
+	/* tpalloc() wants at least one byte */
+	if ((result = tpalloc("CARRAY", NULL, view.len ? (long)view.len : 1L)) == NULL)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "tpalloc(CARRAY, %ld): %d - %s", (long)view.len,
+			tperrno, tpstrerror(tperrno));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		NDRX_LOG(log_error, "%s", tmp);
+		PyBuffer_Release(&view);
+		goto leave_func;
+	}
+
+	memcpy(result, view.buf, (size_t)view.len);
+	*len = (long)view.len;
+	PyBuffer_Release(&view);
+
+leave_func:
+	return result;
+}
+
+/*
+ * Convert CARRAY typed buffer to bytearray (new reference), so that the
+ * object sent back goes out as CARRAY again.
+ */
+PyObject* carray_to_pybuffer(char* carray, long len)
+{
+	return PyByteArray_FromStringAndSize(carray, (Py_ssize_t)(len > 0 ? len : 0));
+}
+
+/*
+ * Serialize UBF buffer to its binary form (Bwrite()) as new string.
+ * The form is the libubf one, PTR field values are written as is and
+ * are meaningful only in the same process.
+ * Returns NULL with Python exception set on failure.
+ */
+PyObject* ubf_to_bytes(UBFH* ubf)
+{
+	PyObject* ret = NULL;
+	char* data = NULL;
+	size_t size = 0;
+	BFLDID ptrid;
+	FILE* f;
+
+	/* a pointer means nothing in another process or buffer */
+	if ((ptrid = ubf_find_ptr(ubf)) != BBADFLDID)
+	{
+		PyErr_Format(PyExc_TypeError, "field %s: PTR fields can not be serialized",
+			Bfname(ptrid));
+		return NULL;
+	}
+
+	if ((f = open_memstream(&data, &size)) == NULL)
+	{
+		PyErr_SetFromErrno(PyExc_OSError);
+		return NULL;
+	}
+
+	if (Bwrite(ubf, f) < 0)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "Bwrite(): %d - %s", Berror, Bstrerror(Berror));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		fclose(f);
+		goto leave_func;
+	}
+
+	if (fclose(f) != 0)
+	{
+		PyErr_SetFromErrno(PyExc_OSError);
+		goto leave_func;
+	}
+
+	ret = PyString_FromStringAndSize(data, (Py_ssize_t)size);
+
+leave_func:
+	free(data);
+	return ret;
+}
+
+/*
+ * Restore UBF buffer from the binary form made by ubf_to_bytes()
+ * (Bread()). The buffer is sized from the data and grown if short.
+ * Returns NULL with Python exception set on failure.
+ */
+UBFH* ubf_from_bytes(char* data, Py_ssize_t len)
+{
+	UBFH* ubf;
+	long size = (long)len + 1024;
+	int tries;
+
+	if ((ubf = ubf_alloc(0, size)) == NULL)
+	{
+		return NULL;
+	}
+
+	for (tries = 0; ; tries++)
+	{
+		FILE* f;
+		int ret;
+
+		if ((f = fmemopen(data, (size_t)len, "rb")) == NULL)
+		{
+			PyErr_SetFromErrno(PyExc_OSError);
+			tpfree((char*)ubf);
+			return NULL;
+		}
+
+		ret = Bread(ubf, f);
+		fclose(f);
+
+		if (ret >= 0)
+		{
+			break;
+		}
 
+		if (BNOSPACE != Berror || tries > 4)
+		{
+			char tmp[200] = "";
+			sprintf(tmp, "Bread(): %d - %s", Berror, Bstrerror(Berror));
+			PyErr_SetString(PyExc_RuntimeError, tmp);
+			tpfree((char*)ubf);
+			return NULL;
+		}
 
+		if (ubf_grow(&ubf, Bsizeof(ubf)) < 0)
+		{
+			tpfree((char*)ubf);
+			return NULL;
+		}
+	}
 
+	return ubf;
+}
@@ -18,10 +18,72 @@
 
 #define NDRXBUFSIZE  16384*2
 
-extern PyObject* ubf_to_dict(UBFH* ubf);
+/* Conversion flags for received buffers (atmi.CONV_*) */
+#define NDRXPY_CONV_PROXY	0x00000001	/* UBF as atmi.UbfProxy, not a dict */
+#define NDRXPY_CONV_INPLACE	0x00000002	/* writable request proxy, returned as is */
+#define NDRXPY_CONV_SCALAR	0x00000004	/* single occurrence as value, not a list */
+#define NDRXPY_CONV_JSON	0x00000008	/* JSON buffer parsed (json module), not JsonStr */
+#define NDRXPY_CONV_ARRAY	0x00000010	/* numeric occurrences as array.array */
+#define NDRXPY_CONV_BORROW	0x40000000	/* internal: proxy must not free the buffer */
+
+/*
+ * Logging on the conversion and dispatch paths. The level is checked
+ * before anything is formatted; -DNDRXPY_NO_HOTLOG compiles it out and
+ * atmi.set_hotlog(0) (or NDRXPY_HOTLOG=0 at import) switches it off.
+ * Buffer and object dumps are done at log_dump only.
+ */
+extern int ndrxpy_hotlog;
+
+#ifdef NDRXPY_NO_HOTLOG
+#define NDRXPY_HOTLOG_ON(lev)	0
+#else
+#define NDRXPY_HOTLOG_ON(lev)	(ndrxpy_hotlog && (lev) <= G_ndrx_debug.level)
+#endif
+
+#define NDRXPY_LOG(lev, ...) \
+	do { if (NDRXPY_HOTLOG_ON(lev)) { NDRX_LOG(lev, __VA_ARGS__); } } while (0)
+
+#define NDRXPY_DUMP_UBF(comment, ubf) \
+	do { if (NDRXPY_HOTLOG_ON(log_dump)) { ndrx_debug_dump_UBF(log_dump, comment, ubf); } } while (0)
+
+#define NDRXPY_DUMP_PY(comment, obj) \
+	do { if (NDRXPY_HOTLOG_ON(log_dump) && NULL != (obj)) { \
+		NDRX_LOG(log_dump, "%s", comment); \
+		PyObject_Print(obj, G_ndrx_debug.dbg_f_ptr, 0); \
+		fprintf(G_ndrx_debug.dbg_f_ptr, "\n"); } } while (0)
+
+extern PyObject* ubf_fldname(BFLDID id);
+extern BFLDID ubf_fldid(PyObject* key);
+extern int ubf_fldcache_preload(void);
+
+extern int ubf_grow(UBFH** pp_ub, long need);
+extern void ubf_size_add(PyObject* vallist, BFLDOCC* nocc, long* datalen);
+extern UBFH* ubf_alloc(BFLDOCC nocc, long datalen);
+extern int ubf_add_field(UBFH** pp_ub, BFLDID id, PyObject* vallist);
+extern int ubf_set_field(UBFH** pp_ub, BFLDID id, PyObject* vallist);
+extern PyObject* ubf_field_to_py(UBFH* ubf, BFLDID id, BFLDOCC oc, long flags);
+extern PyObject* ubf_field_to_list(UBFH* ubf, BFLDID id, long flags);
+extern PyObject* ubf_to_dict(UBFH* ubf, long flags);
+extern int ubf_to_dict_into(UBFH* ubf, PyObject* dict, long flags);
+extern PyObject* ubf_fields_to_dict(UBFH* ubf, BFLDID* fields, long flags);
 extern UBFH* dict_to_ubf(PyObject* dict);
+extern int dict_refill_ubf(UBFH** pp_ub, PyObject* dict, int owned);
+extern UBFH* rows_to_ubf(PyObject* rows);
+extern PyObject* ubf_to_rows(UBFH* ubf, long flags);
+extern int dict_merge_ubf(UBFH** pp_ub, PyObject* dict, BFLDID* fields);
 extern char* pystring_to_string(PyObject* pystring);
 extern PyObject* string_to_pystring(char* string);
+extern char* pybuffer_to_carray(PyObject* pybuf, long* len);
+extern PyObject* carray_to_pybuffer(char* carray, long len);
+extern PyObject* ubf_to_bytes(UBFH* ubf);
+extern UBFH* ubf_from_bytes(char* data, Py_ssize_t len);
+extern PyObject* view_to_py(char* vname, char* cstruct, long flags);
+extern int py_to_view(char* vname, char* cstruct, PyObject* data);
+extern int py_is_view(PyObject* pyvalue);
+extern char* py_to_viewbuf(PyObject* pyvalue, long* len);
+extern int ubf_own_ptrs(UBFH* ubf);
+extern int ubf_free_ptrs(char* buf);
+extern void ubf_tpfree(char* buf);
 
 
 
@@ -0,0 +1,304 @@
+/*
+   This file implements the atmi.BoolExpr type. The expression is compiled
+   once with Bboolco() and the compiled tree is kept in a cache by the
+   expression text, so BoolExpr("...") with the same text gives back the
+   same object as long as it stays in the cache (the cache is dropped
+   when it reaches EXPR_CACHE_MAX texts, so generated expressions do not
+   pile up). Evaluation runs in libubf on the buffer itself, without
+   converting any field to Python.
+
+   (c) 2017 Mavimax, SIA
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atmi.h>     /* ENDUROX Header File */
+#include <ubf.h>    /* ENDUROX Header File */
+
+#include <ndebug.h>
+#include <Python.h>
+#include <structmember.h>
+
+#include "ndrxconvert.h"
+#include "ndrxproxy.h"
+#include "ndrxexpr.h"
+
+#define EXPR_CACHE_MAX	256	/* texts cached before the cache is dropped */
+
+/* expression text -> BoolExpr */
+static PyObject* M_exprcache = NULL;
+
+/*
+ * Get compiled expression for the expression text (or BoolExpr itself),
+ * new reference. Texts are compiled only once.
+ * Returns NULL with Python exception set on failure.
+ */
+PyObject* boolexpr_get(PyObject* expr)
+{
+	BoolExprObject* self;
+	char* tree;
+
+	if (BoolExpr_Check(expr))
+	{
+		Py_INCREF(expr);
+		return expr;
+	}
+
+	if (!PyString_Check(expr))
+	{
+		PyErr_SetString(PyExc_TypeError, "BoolExpr: expression must be a string");
+		return NULL;
+	}
+
+	if (NULL == M_exprcache && (M_exprcache = PyDict_New()) == NULL)
+	{
+		return NULL;
+	}
+
+	if ((self = (BoolExprObject*)PyDict_GetItem(M_exprcache, expr)) != NULL)
+	{
+		Py_INCREF(self);
+		return (PyObject*)self;
+	}
+
+	if ((tree = Bboolco(PyString_AS_STRING(expr))) == NULL)
+	{
+		char tmp[300] = "";
+		sprintf(tmp, "Bboolco(%.200s): %d - %s", PyString_AS_STRING(expr),
+			Berror, Bstrerror(Berror));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		return NULL;
+	}
+
+	if ((self = PyObject_New(BoolExprObject, &BoolExpr_Type)) == NULL)
+	{
+		Btreefree(tree);
+		return NULL;
+	}
+	self->tree = tree;
+	Py_INCREF(expr);
+	self->text = expr;
+
+	/* objects still referenced by callers stay valid */
+	if (PyDict_Size(M_exprcache) >= EXPR_CACHE_MAX)
+	{
+		NDRXPY_LOG(log_debug, "expression cache full, dropped");
+		PyDict_Clear(M_exprcache);
+	}
+
+	if (PyDict_SetItem(M_exprcache, expr, (PyObject*)self) < 0)
+	{
+		Py_DECREF(self);
+		return NULL;
+	}
+
+	NDRX_LOG(log_debug, "compiled expression [%s]", PyString_AS_STRING(expr));
+
+	return (PyObject*)self;
+}
+
+/*
+ * Evaluate the compiled expression on the buffer.
+ * Returns 1 (true), 0 (false) or -1 with Python exception set.
+ */
+int boolexpr_eval(PyObject* expr, UBFH* ubf)
+{
+	int ret;
+
+	if ((ret = Bboolev(ubf, ((BoolExprObject*)expr)->tree)) < 0)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "Bboolev(): %d - %s", Berror, Bstrerror(Berror));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		return -1;
+	}
+
+	return ret ? 1 : 0;
+}
+
+/*
+ * Get the buffer to evaluate on: proxy buffer is used as is (with the
+ * pending changes stored), dictionary is converted to temporary buffer
+ * returned in *tmp (ubf_tpfree() it).
+ */
+static UBFH* boolexpr_buffer(PyObject* buf, UBFH** tmp)
+{
+	*tmp = NULL;
+
+	if (UbfProxy_Check(buf))
+	{
+		if (ubfproxy_sync(buf) < 0)
+		{
+			return NULL;
+		}
+		return ubfproxy_buffer(buf);
+	}
+	else if (PyDict_Check(buf))
+	{
+		return (*tmp = dict_to_ubf(buf));
+	}
+
+	PyErr_SetString(PyExc_TypeError, "BoolExpr: UbfProxy or dictionary expected");
+	return NULL;
+}
+
+static PyObject* boolexpr_ev(BoolExprObject* self, PyObject* args)
+{
+	PyObject* buf;
+	UBFH* ubf;
+	UBFH* tmp;
+	int ret;
+
+	if (!PyArg_ParseTuple(args, "O:ev", &buf) ||
+		(ubf = boolexpr_buffer(buf, &tmp)) == NULL)
+	{
+		return NULL;
+	}
+
+	ret = boolexpr_eval((PyObject*)self, ubf);
+
+	if (tmp)
+	{
+		ubf_tpfree((char*)tmp);
+	}
+
+	if (ret < 0)
+	{
+		return NULL;
+	}
+
+	return PyBool_FromLong(ret);
+}
+
+static PyObject* boolexpr_floatev(BoolExprObject* self, PyObject* args)
+{
+	PyObject* buf;
+	UBFH* ubf;
+	UBFH* tmp;
+	double ret;
+
+	if (!PyArg_ParseTuple(args, "O:floatev", &buf) ||
+		(ubf = boolexpr_buffer(buf, &tmp)) == NULL)
+	{
+		return NULL;
+	}
+
+	ret = Bfloatev(ubf, self->tree);
+
+	if (-1 == ret && Berror)
+	{
+		char tmp_msg[200] = "";
+		sprintf(tmp_msg, "Bfloatev(): %d - %s", Berror, Bstrerror(Berror));
+		PyErr_SetString(PyExc_RuntimeError, tmp_msg);
+	}
+
+	if (tmp)
+	{
+		ubf_tpfree((char*)tmp);
+	}
+
+	if (PyErr_Occurred())
+	{
+		return NULL;
+	}
+
+	return PyFloat_FromDouble(ret);
+}
+
+static PyObject* boolexpr_call(BoolExprObject* self, PyObject* args, PyObject* kwds)
+{
+	return boolexpr_ev(self, args);
+}
+
+static PyObject* boolexpr_repr(BoolExprObject* self)
+{
+	PyObject* text;
+	PyObject* ret;
+
+	if ((text = PyObject_Repr(self->text)) == NULL)
+	{
+		return NULL;
+	}
+
+	ret = PyString_FromFormat("BoolExpr(%s)", PyString_AS_STRING(text));
+	Py_DECREF(text);
+
+	return ret;
+}
+
+static PyObject* boolexpr_tpnew(PyTypeObject* type, PyObject* args, PyObject* kwds)
+{
+	PyObject* text;
+
+	if (!PyArg_ParseTuple(args, "S:BoolExpr", &text))
+	{
+		return NULL;
+	}
+
+	return boolexpr_get(text);
+}
+
+static void boolexpr_dealloc(BoolExprObject* self)
+{
+	if (self->tree)
+	{
+		Btreefree(self->tree);
+	}
+	Py_XDECREF(self->text);
+	PyObject_Del(self);
+}
+
+static PyMethodDef boolexpr_methods[] = {
+	{"ev",		(PyCFunction)boolexpr_ev,	METH_VARARGS, "args: (UbfProxy or dict) -> bool (Bboolev)"},
+	{"floatev",	(PyCFunction)boolexpr_floatev,	METH_VARARGS, "args: (UbfProxy or dict) -> float (Bfloatev)"},
+	{NULL,		NULL,				0}
+};
+
+static PyMemberDef boolexpr_members[] = {
+	{"text",	T_OBJECT, offsetof(BoolExprObject, text), READONLY, "expression source"},
+	{NULL}
+};
+
+PyTypeObject BoolExpr_Type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"atmi.BoolExpr",			/* tp_name */
+	sizeof(BoolExprObject),			/* tp_basicsize */
+	0,					/* tp_itemsize */
+	(destructor)boolexpr_dealloc,		/* tp_dealloc */
+	0,					/* tp_print */
+	0,					/* tp_getattr */
+	0,					/* tp_setattr */
+	0,					/* tp_compare */
+	(reprfunc)boolexpr_repr,		/* tp_repr */
+	0,					/* tp_as_number */
+	0,					/* tp_as_sequence */
+	0,					/* tp_as_mapping */
+	0,					/* tp_hash */
+	(ternaryfunc)boolexpr_call,		/* tp_call */
+	0,					/* tp_str */
+	0,					/* tp_getattro */
+	0,					/* tp_setattro */
+	0,					/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT,			/* tp_flags */
+	"Compiled UBF boolean expression, cached by the expression text",	/* tp_doc */
+	0,					/* tp_traverse */
+	0,					/* tp_clear */
+	0,					/* tp_richcompare */
+	0,					/* tp_weaklistoffset */
+	0,					/* tp_iter */
+	0,					/* tp_iternext */
+	boolexpr_methods,			/* tp_methods */
+	boolexpr_members,			/* tp_members */
+	0,					/* tp_getset */
+	0,					/* tp_base */
+	0,					/* tp_dict */
+	0,					/* tp_descr_get */
+	0,					/* tp_descr_set */
+	0,					/* tp_dictoffset */
+	0,					/* tp_init */
+	0,					/* tp_alloc */
+	boolexpr_tpnew,				/* tp_new */
+};
+
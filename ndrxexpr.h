@@ -0,0 +1,35 @@
+/*
+   This file declares the atmi.BoolExpr type: a compiled UBF boolean
+   expression (Bboolco), evaluated against UBF buffers in C.
+
+   (c) 2017 Mavimax, SIA
+
+
+*/
+
+
+#ifndef NDRXEXPR_H
+#define NDRXEXPR_H
+
+
+
+#include <ubf.h>     /* ENDUROX Header File */
+
+
+typedef struct {
+    PyObject_HEAD
+    char* tree;         /* compiled expression (Bboolco) */
+    PyObject* text;     /* expression source */
+} BoolExprObject;
+
+extern PyTypeObject BoolExpr_Type;
+
+#define BoolExpr_Check(op) PyObject_TypeCheck(op, &BoolExpr_Type)
+
+extern PyObject* boolexpr_get(PyObject* expr);
+extern int boolexpr_eval(PyObject* expr, UBFH* ubf);
+
+
+
+#endif /* NDRXEXPR_H */
+
@@ -0,0 +1,208 @@
+/*
+   This file implements the JSON buffer support. A received JSON buffer
+   is given to Python as atmi.JsonStr (plain copy, not parsed), so it can
+   be forwarded or returned again as JSON buffer; with CONV_JSON it is
+   parsed by the json module (C scanner) instead. JSON <-> UBF is done by
+   Enduro/X itself, without going through Python objects.
+
+   (c) 2017 Mavimax, SIA
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atmi.h>     /* ENDUROX Header File */
+#include <ubf.h>    /* ENDUROX Header File */
+
+#include <ndebug.h>
+#include <Python.h>
+
+#include "ndrxconvert.h"
+#include "ndrxjson.h"
+
+/* json.loads */
+static PyObject* M_json_loads = NULL;
+
+/*
+ * Convert JSON document to Python (new reference): JsonStr, or with
+ * CONV_JSON in flags the parsed document.
+ * Returns NULL with Python exception set on failure.
+ */
+PyObject* json_to_py(char* json, long flags)
+{
+	if (flags & NDRXPY_CONV_JSON)
+	{
+		if (NULL == M_json_loads)
+		{
+			PyObject* mod;
+
+			if ((mod = PyImport_ImportModule("json")) == NULL)
+			{
+				return NULL;
+			}
+			M_json_loads = PyObject_GetAttrString(mod, "loads");
+			Py_DECREF(mod);
+
+			if (NULL == M_json_loads)
+			{
+				return NULL;
+			}
+		}
+
+		return PyObject_CallFunction(M_json_loads, "s", json);
+	}
+
+	return PyObject_CallFunction((PyObject*)&JsonStr_Type, "s", json);
+}
+
+/*
+ * Make JSON typed buffer from the string.
+ * Returns NULL with Python exception set on failure.
+ */
+char* py_to_jsonbuf(PyObject* pyvalue)
+{
+	char* buf;
+	Py_ssize_t len = PyString_GET_SIZE(pyvalue);
+
+	if ((buf = tpalloc("JSON", NULL, len + 1)) == NULL)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "tpalloc(JSON): %d - %s", tperrno, tpstrerror(tperrno));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		return NULL;
+	}
+
+	memcpy(buf, PyString_AS_STRING(pyvalue), len);
+	buf[len] = EXEOS;
+
+	return buf;
+}
+
+/*
+ * Convert JSON document to UBF buffer (tpjsontoubf()). The buffer is
+ * sized from the document length and grown if it does not fit.
+ * Returns NULL with Python exception set on failure.
+ */
+UBFH* json_to_ubf(char* json)
+{
+	UBFH* ubf;
+	long size = (long)strlen(json) + 1024;
+	int tries;
+
+	if ((ubf = (UBFH*)tpalloc("UBF", NULL, size)) == NULL)
+	{
+		goto err_tp;
+	}
+
+	for (tries = 0; tpjsontoubf(ubf, json) < 0; tries++)
+	{
+		UBFH* tmp;
+
+		if (BNOSPACE != Berror || tries > 4)
+		{
+			char msg[200] = "";
+			sprintf(msg, "tpjsontoubf(): %d - %s", tperrno, tpstrerror(tperrno));
+			PyErr_SetString(PyExc_RuntimeError, msg);
+			ubf_tpfree((char*)ubf);
+			return NULL;
+		}
+
+		size *= 2;
+		NDRX_LOG(log_debug, "tpjsontoubf(): no space, growing to %ld", size);
+
+		if ((tmp = (UBFH*)tprealloc((char*)ubf, size)) == NULL)
+		{
+			ubf_tpfree((char*)ubf);
+			goto err_tp;
+		}
+		ubf = tmp;
+		/* partially loaded PTR fields are dropped with the contents */
+		ubf_free_ptrs((char*)ubf);
+		Binit(ubf, size);
+	}
+
+	return ubf;
+
+err_tp:
+	{
+		char msg[200] = "";
+		sprintf(msg, "tpalloc(UBF): %d - %s", tperrno, tpstrerror(tperrno));
+		PyErr_SetString(PyExc_RuntimeError, msg);
+	}
+	return NULL;
+}
+
+/*
+ * Convert UBF buffer to JSON document (tpubftojson()), new JsonStr
+ * reference. Field names make the text several times the buffer size,
+ * the output buffer is doubled until the document fits.
+ * Returns NULL with Python exception set on failure.
+ */
+PyObject* ubf_to_json(UBFH* ubf)
+{
+	PyObject* ret = NULL;
+	char* json = NULL;
+	long size = Bused(ubf) * 4 + 1024;
+	int tries;
+
+	for (tries = 0; ; tries++)
+	{
+		char* tmp;
+
+		if ((tmp = PyMem_Realloc(json, size)) == NULL)
+		{
+			PyErr_NoMemory();
+			goto leave_func;
+		}
+		json = tmp;
+
+		if (tpubftojson(ubf, json, (int)size) == 0)
+		{
+			break;
+		}
+
+		/* only "buffer too short" (TPELIMIT) is worth a retry */
+		if (TPELIMIT != tperrno || tries > 4)
+		{
+			char msg[200] = "";
+			sprintf(msg, "tpubftojson(): %d - %s", tperrno, tpstrerror(tperrno));
+			PyErr_SetString(PyExc_RuntimeError, msg);
+			goto leave_func;
+		}
+
+		size *= 2;
+		NDRX_LOG(log_debug, "tpubftojson(): retry with %ld bytes", size);
+	}
+
+	ret = PyObject_CallFunction((PyObject*)&JsonStr_Type, "s", json);
+
+leave_func:
+	PyMem_Free(json);
+	return ret;
+}
+
+PyTypeObject JsonStr_Type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"atmi.JsonStr",				/* tp_name */
+	0,					/* tp_basicsize (from str) */
+	0,					/* tp_itemsize */
+	0,					/* tp_dealloc */
+	0,					/* tp_print */
+	0,					/* tp_getattr */
+	0,					/* tp_setattr */
+	0,					/* tp_compare */
+	0,					/* tp_repr */
+	0,					/* tp_as_number */
+	0,					/* tp_as_sequence */
+	0,					/* tp_as_mapping */
+	0,					/* tp_hash */
+	0,					/* tp_call */
+	0,					/* tp_str */
+	0,					/* tp_getattro */
+	0,					/* tp_setattro */
+	0,					/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,	/* tp_flags */
+	"JSON document, sent and received as JSON typed buffer",	/* tp_doc */
+};
+
@@ -0,0 +1,32 @@
+/*
+   This file declares the JSON buffer support: atmi.JsonStr (str holding
+   a JSON document, sent as JSON typed buffer) and the JSON <-> UBF
+   conversions done by Enduro/X (tpjsontoubf(), tpubftojson()).
+
+   (c) 2017 Mavimax, SIA
+
+
+*/
+
+
+#ifndef NDRXJSON_H
+#define NDRXJSON_H
+
+
+
+#include <ubf.h>     /* ENDUROX Header File */
+
+
+extern PyTypeObject JsonStr_Type;
+
+#define JsonStr_Check(op) PyObject_TypeCheck(op, &JsonStr_Type)
+
+extern PyObject* json_to_py(char* json, long flags);
+extern char* py_to_jsonbuf(PyObject* pyvalue);
+extern UBFH* json_to_ubf(char* json);
+extern PyObject* ubf_to_json(UBFH* ubf);
+
+
+
+#endif /* NDRXJSON_H */
+
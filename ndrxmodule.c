@@ -13,12 +13,14 @@
 /* {{{ includes */
 
 #include <stdio.h>              /* System header file */
+#include <stdlib.h>             /* System header file */
 
 #ifdef USE_THREADS
 #include <pthread.h>            /* System header file */  
 #endif /* USE_THREADS */
 
 #include <string.h>
+#include <time.h>
 #include <xa.h>                 /* ENDUROX Header File */
 #include <atmi.h>               /* ENDUROX Header File */
 #include "ubf.h"                /* ENDUROX Header File */
@@ -32,6 +34,13 @@
 #include <ndebug.h>
 #include "ndrxconvert.h"         /* Needed for some helper functions to convert Python 
 				   data types to ENDUROX data types and vice versa */
+#include "ndrxproxy.h"           /* atmi.UbfProxy type */
+#include "ndrxexpr.h"            /* atmi.BoolExpr type */
+#include "ndrxschema.h"          /* atmi.Schema, atmi.Record types */
+#include "ndrxjson.h"            /* atmi.JsonStr type, JSON <-> UBF */
+#include "ndrxaggr.h"            /* reductions over field occurrences */
+#include "ndrxcall.h"            /* atmi.PreparedCall type */
+#include "ndrxpool.h"            /* reply buffer pool */
 
 
 /* }}} */
@@ -39,6 +48,11 @@
 
 #define MAX_PY_SERVICES       100
 
+/* Run a blocking ATMI call with the GIL released, so that other Python
+   threads go on meanwhile. `stmt' must not touch Python objects; the ATMI
+   context is per thread, thus stays with the calling thread. */
+#define NDRXPY_NOGIL(stmt) do { Py_BEGIN_ALLOW_THREADS stmt; Py_END_ALLOW_THREADS } while (0)
+
 #define MAX_SVC_NAME_LEN      15 + 1 
 #define MAX_METHOD_NAME_LEN      1024 
 
@@ -46,6 +60,15 @@
 typedef struct {
     char name[MAX_SVC_NAME_LEN];  /* constant from atmi.h */
     char method[MAX_METHOD_NAME_LEN];            
+    long convflags;               /* CONV_* flags, -1: use module default */
+    BFLDID* fields;               /* fields to decode (BBADFLDID terminated),
+                                     NULL: all of them */
+    PyObject* filter;             /* atmi.BoolExpr the UBF requests must
+                                     match, NULL: no filter */
+    char filter_forward[MAX_SVC_NAME_LEN]; /* where non-matching requests go,
+                                     empty: TPFAIL */
+    PyObject* schema;             /* atmi.Schema, UBF requests come as
+                                     atmi.Record, NULL: no schema */
 } service_entry;
 
 
@@ -63,9 +86,12 @@ void endurox_dispatch(TPSVCINFO * rqst);
 static PyObject * makeargvobject(int argc, char** argv);
 static int find_entry(const char* name);
 static int find_free_entry(const char* name);
-static char* transform_py_to_ndrx(PyObject* res_py);
-static PyObject* transform_ndrxpy_to_py(char* ndrxbuf);
+static BFLDID* parse_fields(PyObject* fields_py);
+static char* transform_py_to_ndrx(PyObject* res_py, long* len);
+static PyObject* transform_ndrxpy_to_py(char** ndrxbuf, long len, long flags);
 static PyObject* ndrxpy_tppost(PyObject* self, PyObject* arg);
+static PyObject* ndrxpy_tpgetrplyex(PyObject* self, PyObject* arg);
+static PyObject* ndrxpy_tpcall_many(PyObject* self, PyObject* arg, PyObject* kw);
 static PyObject* ndrxpy_tpsubscribe(PyObject* self, PyObject* arg);
 static PyObject* ndrxpy_tpunsubscribe(PyObject* self, PyObject* arg);
 static PyObject* ndrxpy_tpnotify(PyObject* self, PyObject* arg);
@@ -78,7 +104,7 @@ static PyObject * ndrxpy_tpacall(PyObject * self, PyObject * args);
 static PyObject * ndrxpy_tpadmcall(PyObject * self, PyObject * args);
 static PyObject * ndrxpy_tpforward(PyObject * self, PyObject * args);
 static PyObject * ndrx_mainloop(PyObject * self, PyObject * args);
-static PyObject* ndrxpy_tpadvertise(PyObject* self, PyObject* arg);
+static PyObject* ndrxpy_tpadvertise(PyObject* self, PyObject* arg, PyObject* kw);
 static PyObject* ndrxpy_tpunadvertise(PyObject* self, PyObject* arg);
 static PyObject * ndrxpy_tpopen(PyObject * self, PyObject * args);
 static PyObject * ndrxpy_tpclose(PyObject * self, PyObject * args);
@@ -106,6 +132,24 @@ static PyObject* ndrxpy_set_tpurcode(PyObject* self, PyObject * args);
 static PyObject * ndrxpy_tpenqueue(PyObject * self, PyObject * args);
 static PyObject * ndrxpy_tpdequeue(PyObject * self, PyObject * args);
 static PyObject * ndrxpy_tpgetnodeid(PyObject * self, PyObject * args);
+static PyObject * ndrxpy_fldcache_preload(PyObject * self, PyObject * args);
+static PyObject * ndrxpy_get_convflags(PyObject * self, PyObject * args);
+static PyObject * ndrxpy_set_convflags(PyObject * self, PyObject * args);
+static PyObject * ndrxpy_set_hotlog(PyObject * self, PyObject * args);
+static PyObject * ndrxpy_tpjsontoubf(PyObject * self, PyObject * args);
+static PyObject * ndrxpy_tpubftojson(PyObject * self, PyObject * args);
+static PyObject * ndrxpy_ubf_sum(PyObject * self, PyObject * args);
+static PyObject * ndrxpy_ubf_min(PyObject * self, PyObject * args);
+static PyObject * ndrxpy_ubf_max(PyObject * self, PyObject * args);
+static PyObject * ndrxpy_ubf_count(PyObject * self, PyObject * args);
+static PyObject * ndrxpy_ubf_mean(PyObject * self, PyObject * args);
+static PyObject * ndrxpy_ubf_distinct(PyObject * self, PyObject * args);
+static PyObject * ndrxpy_ubf_tobytes(PyObject * self, PyObject * args);
+static PyObject * ndrxpy_ubf_frombytes(PyObject * self, PyObject * args);
+static PyObject * ndrxpy_ubf_to_dict(PyObject * self, PyObject * args, PyObject * kw);
+static PyObject * ndrxpy_dict_to_ubf(PyObject * self, PyObject * args, PyObject * kw);
+static PyObject * ndrxpy_rows_to_ubf(PyObject * self, PyObject * args);
+static PyObject * ndrxpy_ubf_to_rows(PyObject * self, PyObject * args);
 
 /* }}} */
 /* {{{ local variables */
@@ -123,7 +167,7 @@ static PyMethodDef ndrxpy_methods[] = {
     {"tpadmcall",	 ndrxpy_tpadmcall,	    METH_VARARGS, "args: ({args}|'flags')"},
     {"tpopen",           ndrxpy_tpopen,	    METH_VARARGS, ""},
     {"tpclose",          ndrxpy_tpclose,	    METH_VARARGS, ""},
-    {"tpadvertise",      ndrxpy_tpadvertise,   METH_VARARGS},
+    {"tpadvertise",      (PyCFunction)ndrxpy_tpadvertise, METH_VARARGS|METH_KEYWORDS, "args: ('service', ['method'], [convflags], [fields], [filter], [filter_forward], [schema])"},
     {"tpunadvertise",    ndrxpy_tpunadvertise, METH_VARARGS},
     {"mainloop",	 ndrx_mainloop,	    METH_VARARGS},
     {"tpforward",	 ndrxpy_tpforward,	    METH_VARARGS, "args: ('service', {args}|'args')"},
@@ -136,6 +180,8 @@ static PyMethodDef ndrxpy_methods[] = {
     {"tprecv",           ndrxpy_tprecv,	    METH_VARARGS, ""},
     {"tpdiscon",	 ndrxpy_tpdiscon,	    METH_VARARGS, ""},
     {"tpgetrply",	 ndrxpy_tpgetrply,	    METH_VARARGS, ""},
+    {"tpgetrplyex",	 ndrxpy_tpgetrplyex,	    METH_VARARGS, "args: ([flags]) -> (cd, data, tperrno, tpurcode) | None, any reply"},
+    {"tpcall_many",      (PyCFunction)ndrxpy_tpcall_many, METH_VARARGS|METH_KEYWORDS, "args: ([('service', {args}|'args', [flags]), ...], [timeout]) -> [(tperrno, tpurcode, data), ...]"},
     {"tpenqueue",	 ndrxpy_tpenqueue,	    METH_VARARGS, "args: ('qspace', 'qname', data, {qctl})"},
     {"tpdequeue",	 ndrxpy_tpdequeue,	    METH_VARARGS, "args: ('qspace', 'qname', {qctl})"},
     {"tppost",           ndrxpy_tppost,        METH_VARARGS},
@@ -150,6 +196,24 @@ static PyMethodDef ndrxpy_methods[] = {
     {"get_tpurcode",     ndrxpy_get_tpurcode,  METH_VARARGS},
     {"set_tpurcode",     ndrxpy_set_tpurcode,  METH_VARARGS},
     {"tpgetnodeid",      ndrxpy_tpgetnodeid,   METH_VARARGS, ""},
+    {"fldcache_preload", ndrxpy_fldcache_preload, METH_VARARGS, "args: () -> number of fields loaded"},
+    {"get_convflags",    ndrxpy_get_convflags, METH_VARARGS, "args: () -> CONV_* flags"},
+    {"set_convflags",    ndrxpy_set_convflags, METH_VARARGS, "args: (CONV_* flags) -> old flags"},
+    {"set_hotlog",       ndrxpy_set_hotlog,    METH_VARARGS, "args: (on) -> old setting; conversion/dispatch logging"},
+    {"tpjsontoubf",      ndrxpy_tpjsontoubf,   METH_VARARGS, "args: ('json', [convflags]) -> dict|UbfProxy"},
+    {"tpubftojson",      ndrxpy_tpubftojson,   METH_VARARGS, "args: (dict|UbfProxy|Record) -> JsonStr"},
+    {"ubf_sum",          ndrxpy_ubf_sum,       METH_VARARGS, "args: (dict|UbfProxy|Record, 'field') -> sum of occurrences"},
+    {"ubf_min",          ndrxpy_ubf_min,       METH_VARARGS, "args: (dict|UbfProxy|Record, 'field') -> smallest occurrence or None"},
+    {"ubf_max",          ndrxpy_ubf_max,       METH_VARARGS, "args: (dict|UbfProxy|Record, 'field') -> largest occurrence or None"},
+    {"ubf_count",        ndrxpy_ubf_count,     METH_VARARGS, "args: (dict|UbfProxy|Record, 'field') -> number of occurrences"},
+    {"ubf_mean",         ndrxpy_ubf_mean,      METH_VARARGS, "args: (dict|UbfProxy|Record, 'field') -> mean of occurrences or None"},
+    {"ubf_distinct",     ndrxpy_ubf_distinct,  METH_VARARGS, "args: (dict|UbfProxy|Record, 'field') -> number of distinct values"},
+    {"ubf_tobytes",      ndrxpy_ubf_tobytes,   METH_VARARGS, "args: (dict|UbfProxy|Record) -> binary UBF (Bwrite)"},
+    {"ubf_frombytes",    ndrxpy_ubf_frombytes, METH_VARARGS, "args: (data, [convflags]) -> dict|UbfProxy (Bread)"},
+    {"ubf_to_dict",      (PyCFunction)ndrxpy_ubf_to_dict, METH_VARARGS|METH_KEYWORDS, "args: (UbfProxy|dict|Record, [into], [convflags]) -> dict"},
+    {"dict_to_ubf",      (PyCFunction)ndrxpy_dict_to_ubf, METH_VARARGS|METH_KEYWORDS, "args: ({fields}, [into]) -> UbfProxy"},
+    {"rows_to_ubf",      ndrxpy_rows_to_ubf,   METH_VARARGS, "args: ([{row}, ...]) -> UbfProxy, row i = occurrence i"},
+    {"ubf_to_rows",      ndrxpy_ubf_to_rows,   METH_VARARGS, "args: (UbfProxy|dict|Record, [convflags]) -> [{row}, ...]"},
     {NULL,		 NULL,		    0}
 };
 
@@ -186,6 +250,9 @@ static PyObject* _forward_pydata = NULL;
 /* Holds the Unsolicited Message Handler function */
 static PyObject * py_unsol_handler = NULL;
 
+/* Default conversion flags (CONV_*) for received buffers */
+static long _convflags = 0;
+
 
 /* }}} */
 
@@ -294,6 +361,10 @@ static int delete_entry(const char* name) {
 	if (!strcmp(_registered_services[i].name, name)) {
 	    _registered_services[i].name[0]   = '\0';
 	    _registered_services[i].method[0] = '\0';
+	    free(_registered_services[i].fields);
+	    _registered_services[i].fields = NULL;
+	    Py_CLEAR(_registered_services[i].filter);
+	    Py_CLEAR(_registered_services[i].schema);
 	    return i;
 	}
     }
@@ -302,6 +373,63 @@ static int delete_entry(const char* name) {
 
 /* }}} */
 
+/* {{{ parse_fields() */
+
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+  Resolve a sequence of field names or ids to a BBADFLDID terminated
+  array of field ids (free() it)
+
+  BFLDID* parse_fields  Return: field id array or NULL on error (Python
+                                exception set)
+
+  PyObject* fields_py   sequence of field names / ids                     :IN
+  +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+static BFLDID* parse_fields(PyObject* fields_py) {
+    PyObject* seq = NULL;
+    BFLDID* fields = NULL;
+    Py_ssize_t i, n;
+
+    if ((seq = PySequence_Fast(fields_py, "fields must be a sequence")) == NULL) {
+	goto leave_func;
+    }
+    n = PySequence_Fast_GET_SIZE(seq);
+
+    if ((fields = (BFLDID*)malloc(sizeof(BFLDID) * (n + 1))) == NULL) {
+	PyErr_NoMemory();
+	goto leave_func;
+    }
+
+    for (i = 0; i < n; i++) {
+	PyObject* item = PySequence_Fast_GET_ITEM(seq, i);
+
+	if (PyInt_Check(item) || PyLong_Check(item)) {
+	    fields[i] = (BFLDID)PyInt_AsLong(item);
+	    if (Bfname(fields[i]) == NULL) {
+		char tmp[200] = "";
+		sprintf(tmp, "Bfname(%ld): %d - %s", (long)fields[i], Berror, Bstrerror(Berror));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		fields[i] = BBADFLDID;
+	    }
+	} else {
+	    fields[i] = ubf_fldid(item);
+	}
+
+	if (BBADFLDID == fields[i]) {
+	    free(fields);
+	    fields = NULL;
+	    goto leave_func;
+	}
+    }
+    fields[n] = BBADFLDID;
+
+ leave_func:
+    Py_XDECREF(seq);
+    return fields;
+}
+
+/* }}} */
+
 /* {{{ ins() */
 
 /*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -331,23 +459,41 @@ ins(PyObject *d, char *s, long x)
 
 /*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
   This function checks for the Python-type of its arguments and returns a
-  corresponding ENDUROX typed buffer. Currently, only strings or
-  dictionaries are allowed
+  corresponding ENDUROX typed buffer. Currently, only strings,
+  dictionaries, UbfProxy / Record objects or objects supporting the buffer
+  protocol (bytearray, memoryview, buffer -> CARRAY) are allowed. A
+  dictionary of exactly {"vname": name, "data": {...}} is a VIEW buffer,
+  an atmi.JsonStr a JSON buffer
 
   char* transform_py_to_ndrx   Return: pointer to a ENDUROX typed buffer
 
   PyObject* res_py            Python object                             :IN
+
+  long* len                   data length to pass to ATMI (0 if the
+                              buffer type knows it by itself)          :OUT
   +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
 
 
-static char* transform_py_to_ndrx(PyObject* res_py) {
+static char* transform_py_to_ndrx(PyObject* res_py, long* len) {
     char* res_ndrx = NULL;
-    if (PyDict_Check(res_py)) {
+    *len = 0;
+    if (py_is_view(res_py)) {
+	res_ndrx = py_to_viewbuf(res_py, len);
+    } else if (PyDict_Check(res_py)) {
 	res_ndrx = (char*)dict_to_ubf(res_py);
+    } else if (UbfProxy_Check(res_py)) {
+	res_ndrx = (char*)ubfproxy_copy(res_py);
+    } else if (Record_Check(res_py)) {
+	res_ndrx = (char*)record_to_ubf(res_py);
+    } else if (JsonStr_Check(res_py)) {
+	res_ndrx = py_to_jsonbuf(res_py);
     } else if (PyString_Check(res_py)) {
 	res_ndrx = pystring_to_string(res_py);
+    } else if (!PyUnicode_Check(res_py) &&
+	    (PyObject_CheckBuffer(res_py) || PyObject_CheckReadBuffer(res_py))) {
+	res_ndrx = pybuffer_to_carray(res_py, len);
     } else {
-	PyErr_SetString(PyExc_RuntimeError, "Only String or Dictionary arguments are allowed");
+	PyErr_SetString(PyExc_RuntimeError, "Only String, Dictionary or buffer arguments are allowed");
     }
     return res_ndrx;
 }    
@@ -358,21 +504,31 @@ static char* transform_py_to_ndrx(PyObject* res_py) {
 
 /*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
   This function converts a ENDUROX typed buffer to the corresponding Python
-  types (string or dictionary). Currently, only STRING and UBF buffers
-  are allowed.
+  types (string, dictionary or bytearray). Currently, only STRING, UBF,
+  VIEW ({"vname": name, "data": {...}}), JSON (atmi.JsonStr, or parsed
+  with CONV_JSON) and CARRAY buffers are allowed. With CONV_PROXY, a UBF buffer is wrapped
+  in an UbfProxy which takes over the buffer (*ndrxbuf is set to NULL),
+  unless NDRXPY_CONV_BORROW is given too. CONV_INPLACE makes a borrowed
+  proxy writable. With CONV_SCALAR, the dictionary holds single
+  occurrences as plain values, with CONV_ARRAY numeric fields as
+  array.array.
 
   PyObject* transform_ndrxpy_to_py  Return: Python object 
 
-  char* ndrxbuf                   pointer to a ENDUROX typed buffer         :IN
+  char** ndrxbuf                  pointer to a ENDUROX typed buffer     :IN/OUT
+
+  long len                        data length as received from ATMI        :IN
+
+  long flags                      CONV_* conversion flags                   :IN
   +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
 
 
-static PyObject* transform_ndrxpy_to_py(char* ndrxbuf) {
+static PyObject* transform_ndrxpy_to_py(char** ndrxbuf, long len, long flags) {
     char buffer_type[100] = "";
     char buffer_subtype[100] = "";
     PyObject* obj = NULL;
 
-    if (tptypes(ndrxbuf, buffer_type, buffer_subtype) < 0) {
+    if (tptypes(*ndrxbuf, buffer_type, buffer_subtype) < 0) {
 	char tmp[200] = "";
 	sprintf(tmp, "tptypes() : %d - %s", tperrno, tpstrerror(tperrno));
 	PyErr_SetString(PyExc_RuntimeError, tmp);
@@ -380,33 +536,82 @@ static PyObject* transform_ndrxpy_to_py(char* ndrxbuf) {
     }
 
 
-    if (!strcmp(buffer_type, "UBF")) {
-	if ((obj = ubf_to_dict((UBFH*)ndrxbuf)) == NULL) {
+    if (!strcmp(buffer_type, "UBF") && (flags & (NDRXPY_CONV_PROXY|NDRXPY_CONV_INPLACE))) {
+	if ((obj = ubfproxy_new((UBFH*)*ndrxbuf, !(flags & NDRXPY_CONV_BORROW),
+				(flags & NDRXPY_CONV_INPLACE))) == NULL) {
+	    goto leave_func;
+	}
+	if (!(flags & NDRXPY_CONV_BORROW)) {
+	    *ndrxbuf = NULL; /* owned by the proxy now */
+	}
+    } else if (!strcmp(buffer_type, "UBF")) {
+	if ((obj = ubf_to_dict((UBFH*)*ndrxbuf, flags)) == NULL) {
 
-	    NDRX_LOG(log_debug, "no ubf buffer");
+	    NDRX_LOG(log_error, "no ubf buffer");
 
 	    goto leave_func;
 	}	
     } else if (!strcmp(buffer_type, "STRING")) {
-	if ((obj = string_to_pystring((char*)ndrxbuf)) == NULL) {
+	if ((obj = string_to_pystring((char*)*ndrxbuf)) == NULL) {
+
+	    NDRX_LOG(log_error, "no string buffer");
+
+	    goto leave_func;
+	}	
+    } else if (!strcmp(buffer_type, "JSON")) {
+	if ((obj = json_to_py(*ndrxbuf, flags)) == NULL) {
+
+	    NDRX_LOG(log_error, "no json buffer");
+
+	    goto leave_func;
+	}	
+    } else if (!strcmp(buffer_type, "VIEW")) {
+	if ((obj = view_to_py(buffer_subtype, *ndrxbuf, flags)) == NULL) {
+
+	    NDRX_LOG(log_error, "no view buffer");
+
+	    goto leave_func;
+	}	
+    } else if (!strcmp(buffer_type, "CARRAY")) {
+	if ((obj = carray_to_pybuffer(*ndrxbuf, len)) == NULL) {
 
-	    NDRX_LOG(log_debug, "no string buffer");
+	    NDRX_LOG(log_error, "no carray buffer");
 
 	    goto leave_func;
 	}	
+    } else {
+	char tmp[200] = "";
+	sprintf(tmp, "Unsupported buffer type <%s>", buffer_type);
+	PyErr_SetString(PyExc_RuntimeError, tmp);
     }	
 
  leave_func:
 
-	if (G_ndrx_debug.level>=5)
-	{
-		PyObject_Print(obj, G_ndrx_debug.dbg_f_ptr, 0);
-		fprintf(G_ndrx_debug.dbg_f_ptr, "");
-	}
+    NDRXPY_DUMP_PY("transform_ndrxpy_to_py result:", obj);
 
     return obj;
 }
 
+/* }}} */
+/* {{{ ndrxpy_reply_to_py() */
+
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+  Convert a reply buffer with the module conversion flags, for callers
+  outside this file (atmi.PreparedCall). As with transform_ndrxpy_to_py(),
+  *ndrxbuf is set to NULL if an UbfProxy took the buffer over; it is
+  never borrowed, as the caller reuses the buffer
+
+  PyObject* ndrxpy_reply_to_py    Return: Python object
+
+  char** ndrxbuf                  pointer to a ENDUROX typed buffer     :IN/OUT
+
+  long len                        data length as received from ATMI        :IN
+  +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+PyObject* ndrxpy_reply_to_py(char** ndrxbuf, long len) {
+    return transform_ndrxpy_to_py(ndrxbuf, len, _convflags & ~NDRXPY_CONV_BORROW);
+}
+
 /* }}} */
 
 #ifndef NDRXWS
@@ -432,7 +637,8 @@ mainloop(int argc, char** argv) {
 #include "mainexit.h"
 #endif
     
-    ndrx_main(argc, argv);
+    /* services take the GIL in endurox_dispatch() */
+    NDRXPY_NOGIL(ndrx_main(argc, argv));
 }
 
 /* }}} */
@@ -446,6 +652,7 @@ mainloop(int argc, char** argv) {
 static PyObject * 
 ndrxpy_tpcall(PyObject * self, PyObject * args)
 {
+    int rc = -1;
     PyObject * result = NULL;
     PyObject * input_py = NULL;
     PyObject * flags_py = NULL;
@@ -454,6 +661,7 @@ ndrxpy_tpcall(PyObject * self, PyObject * args)
     char* service_name;
     char* ndrxbuf = NULL;
     
+    long inlen = 0;
     long outlen = 0;
     long flags = 0;
 
@@ -477,30 +685,31 @@ ndrxpy_tpcall(PyObject * self, PyObject * args)
 	}
     }
 
-    if ((ndrxbuf = transform_py_to_ndrx(input_py)) == NULL) {
+    if ((ndrxbuf = transform_py_to_ndrx(input_py, &inlen)) == NULL) {
 	goto leave_func;
     }
 
-    {
+    if (NDRXPY_HOTLOG_ON(log_debug)) {
 	char bubfname[200] = "";
 	tptypes(ndrxbuf, bubfname, NULL);
 	NDRX_LOG(log_debug, "calling tpcall(%s, [%s]...)", service_name, bubfname);
     }
 
     
-    if (tpcall(service_name, ndrxbuf, 0, &ndrxbuf, &outlen, flags ) < 0) {
+    NDRXPY_NOGIL(rc = tpcall(service_name, ndrxbuf, inlen, &ndrxbuf, &outlen, flags ));
+    if (rc < 0) {
 	char tmp[200] = "";
 	sprintf(tmp, "tpcall(): %d - %s", tperrno, tpstrerror(tperrno));
 	PyErr_SetString(PyExc_RuntimeError, tmp);
 	goto leave_func;
     }
     
-    if ((result = transform_ndrxpy_to_py(ndrxbuf)) == NULL) {
+    if ((result = transform_ndrxpy_to_py(&ndrxbuf, outlen, _convflags)) == NULL) {
 	goto leave_func;
     }
 
  leave_func:
-    if (ndrxbuf) tpfree(ndrxbuf);
+    if (ndrxbuf) ubf_tpfree(ndrxbuf);
     return result;
 }
 
@@ -512,6 +721,7 @@ ndrxpy_tpcall(PyObject * self, PyObject * args)
 static PyObject * 
 ndrxpy_tpadmcall(PyObject * self, PyObject * args)
 {
+    int rc = -1;
     PyObject * result = NULL;
     PyObject * input_py = NULL;
     PyObject * flags_py = NULL;
@@ -519,6 +729,7 @@ ndrxpy_tpadmcall(PyObject * self, PyObject * args)
     char bubfname[200] = "";
     char* ndrxbuf = NULL;
     
+    long inlen = 0;
     long flags = 0;
 
     if (PyArg_ParseTuple(args, "O|O", &input_py, &flags_py) < 0) {
@@ -532,7 +743,7 @@ ndrxpy_tpadmcall(PyObject * self, PyObject * args)
 	}
     }
 
-    if ((ndrxbuf = transform_py_to_ndrx(input_py)) == NULL) {
+    if ((ndrxbuf = transform_py_to_ndrx(input_py, &inlen)) == NULL) {
 	goto leave_func;
     }
 
@@ -543,13 +754,10 @@ ndrxpy_tpadmcall(PyObject * self, PyObject * args)
       goto leave_func;
     }
       
-    {
-	char bubfname[200] = "";
-	tptypes(ndrxbuf, bubfname, NULL);
-	NDRX_LOG(log_debug, "calling tpadmcall([%s]...)", bubfname);
-    }
+    NDRXPY_LOG(log_debug, "calling tpadmcall([%s]...)", bubfname);
     
-    if (tpadmcall((UBFH*)ndrxbuf, (UBFH**)&ndrxbuf, flags ) < 0) {
+    NDRXPY_NOGIL(rc = tpadmcall((UBFH*)ndrxbuf, (UBFH**)&ndrxbuf, flags ));
+    if (rc < 0) {
 	char tmp[200] = "";
 	sprintf(tmp, "tpadmcall(): %d - %s", tperrno, tpstrerror(tperrno));
 	PyErr_SetString(PyExc_RuntimeError, tmp);
@@ -558,12 +766,12 @@ ndrxpy_tpadmcall(PyObject * self, PyObject * args)
     
 
     
-    if ((result = transform_ndrxpy_to_py(ndrxbuf)) == NULL) {
+    if ((result = transform_ndrxpy_to_py(&ndrxbuf, 0, _convflags)) == NULL) {
 	goto leave_func;
     }
 
  leave_func:
-    if (ndrxbuf) tpfree(ndrxbuf);
+    if (ndrxbuf) ubf_tpfree(ndrxbuf);
     return result;
 }
 
@@ -587,6 +795,7 @@ ndrxpy_tpacall(PyObject * self, PyObject * args)
     char* ndrxbuf = NULL;
     
     
+    long inlen = 0;
     long flags = 0;
     int handle = -1;
     
@@ -610,16 +819,18 @@ ndrxpy_tpacall(PyObject * self, PyObject * args)
 	}
     }
 
-    if ((ndrxbuf = transform_py_to_ndrx(input_py)) == NULL) {
+    if ((ndrxbuf = transform_py_to_ndrx(input_py, &inlen)) == NULL) {
 	goto leave_func;
     }
 
-    if ((handle = tpacall(service_name, ndrxbuf, 0, flags)) < 0) {
+    NDRXPY_NOGIL(handle = tpacall(service_name, ndrxbuf, inlen, flags));
+    if (handle < 0) {
       char tmp[200] = "";
       sprintf(tmp, "tpacall(): %d - %s", tperrno, tpstrerror(tperrno));
       PyErr_SetString(PyExc_RuntimeError, tmp);
       goto leave_func;
     }
+    replysize_call(handle, service_name);
     
     if (! handle) {
       Py_INCREF(Py_None);
@@ -629,7 +840,7 @@ ndrxpy_tpacall(PyObject * self, PyObject * args)
     }
 
  leave_func:
-    if (ndrxbuf) tpfree(ndrxbuf);
+    if (ndrxbuf) ubf_tpfree(ndrxbuf);
     return result;
 }
 
@@ -639,6 +850,7 @@ ndrxpy_tpacall(PyObject * self, PyObject * args)
 static PyObject * 
 ndrxpy_tpgetrply(PyObject * self, PyObject * args)
 {
+    int rc = -1;
     PyObject * result    = NULL;
     PyObject * flags_py  = NULL;
 
@@ -652,9 +864,9 @@ ndrxpy_tpgetrply(PyObject * self, PyObject * args)
 	goto leave_func;
     }	
 
-    /* Buffer type will be changed by tpgetrply() if necessary */
-    if ((ndrxbuf = tpalloc("UBF", NULL, NDRXBUFSIZE)) == NULL) {
-	NDRX_LOG(log_debug, "tpalloc(): %d - %s\n", tperrno, tpstrerror(tperrno));
+    /* Buffer type will be changed by tpgetrply() if necessary, the size
+       follows the replies the service gave recently */
+    if ((ndrxbuf = bufpool_get("UBF", replysize_hint(handle))) == NULL) {
 	goto leave_func;
     }
 
@@ -664,29 +876,378 @@ ndrxpy_tpgetrply(PyObject * self, PyObject * args)
 	    goto leave_func;
 	}
     }
-    
-    if (Binit((UBFH*)ndrxbuf, NDRXBUFSIZE) < 0) {
-	NDRX_LOG(log_debug, "tpgetrply(): Binit(): %s\n", Bstrerror(Berror));
-	goto leave_func;
-    }
 
     if (handle == 0) {
 	flags |= TPGETANY;
     }
 
-    if (tpgetrply(&handle, &ndrxbuf, &outlen, flags) < 0) {
+    NDRXPY_NOGIL(rc = tpgetrply(&handle, &ndrxbuf, &outlen, flags));
+    if (rc < 0) {
 	char tmp[200] = "";
 	sprintf(tmp, "tgetrply(): %d -  %s", tperrno, tpstrerror(tperrno));
 	PyErr_SetString(PyExc_RuntimeError, tmp);
 	goto leave_func;
     }
+    replysize_note(handle, ndrxbuf, outlen);
     
-    if ((result = transform_ndrxpy_to_py(ndrxbuf)) == NULL) {
+    if ((result = transform_ndrxpy_to_py(&ndrxbuf, outlen, _convflags)) == NULL) {
 	goto leave_func;
     }
     
  leave_func:
-    if (ndrxbuf) tpfree(ndrxbuf);
+    if (ndrxbuf) bufpool_put(ndrxbuf);
+    return result;
+}
+
+/* }}} */
+
+/* {{{ ndrxpy_tpgetrplyex() */
+
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+  tpgetrply(TPGETANY) for reply dispatchers (endurox.aio): the call
+  descriptor comes back with the reply, and call failures are reported
+  in the result instead of raising, so they can go to the matching
+  caller. With TPNOBLOCK, None is returned if no reply is there yet
+
+  PyObject* ndrxpy_tpgetrplyex   Return: (cd, data, tperrno, tpurcode),
+                                 data is None if there is no reply buffer
+
+  long flags                     TPNOBLOCK, TPNOTIME, ...                  :IN
+  +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+static PyObject* ndrxpy_tpgetrplyex(PyObject* self, PyObject* arg) {
+    PyObject* result = NULL;
+    PyObject* data = NULL;
+    char* ndrxbuf = NULL;
+    int handle = 0;
+    long outlen = 0;
+    long flags = 0;
+    int rc = -1;
+    int err = 0;
+
+    if (!PyArg_ParseTuple(arg, "|l", &flags)) {
+	goto leave_func;
+    }
+
+    /* Buffer type will be changed by tpgetrply() if necessary */
+    if ((ndrxbuf = bufpool_get("UBF", replysize_hint(0))) == NULL) {
+	goto leave_func;
+    }
+
+    NDRXPY_NOGIL(rc = tpgetrply(&handle, &ndrxbuf, &outlen, flags | TPGETANY));
+    if (rc < 0) {
+	err = tperrno;
+
+	if (TPEBLOCK == err) {
+	    Py_INCREF(Py_None);
+	    result = Py_None;
+	    goto leave_func;
+	}
+
+	/* failure not bound to a call */
+	if (handle <= 0) {
+	    char tmp[200] = "";
+	    sprintf(tmp, "tpgetrply(): %d - %s", err, tpstrerror(err));
+	    PyErr_SetString(PyExc_RuntimeError, tmp);
+	    goto leave_func;
+	}
+    }
+
+    /* the service may have replied with data on failure too */
+    if (NULL != ndrxbuf && (0 == err || TPESVCFAIL == err)) {
+	replysize_note(handle, ndrxbuf, outlen);
+	if ((data = transform_ndrxpy_to_py(&ndrxbuf, outlen, _convflags)) == NULL) {
+	    goto leave_func;
+	}
+    } else {
+	Py_INCREF(Py_None);
+	data = Py_None;
+    }
+
+    result = Py_BuildValue("(iOil)", handle, data, err, (long)tpurcode);
+
+ leave_func:
+    Py_XDECREF(data);
+    if (ndrxbuf) bufpool_put(ndrxbuf);
+    return result;
+}
+
+/* }}} */
+
+/* {{{ ndrxpy_tpcall_many() */
+
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+  Fan-out call: all requests are converted first, then issued with tpacall()
+  and their replies collected with tpgetrply() in one loop without the GIL.
+  The request buffer of each call receives its reply.
+
+  PyObject* ndrxpy_tpcall_many   Return: list of (tperrno, tpurcode, data)
+                                 in order of calls, tperrno 0 on success;
+                                 data is None if the call got no reply buffer
+
+  list calls                     [(service, data, [flags]), ...]           :IN
+
+  int timeout                    deadline in seconds for the whole fan-out,
+                                 calls still open then are cancelled and
+                                 get TPETIME, except those with TPNOTIME;
+                                 0 - the usual ATMI timeout               :IN
+  +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+typedef struct {
+    char svc[MAX_SVC_NAME_LEN+1];
+    char* buf;
+    long len;
+    long flags;
+    int cd;
+    int done;
+    int err;
+    long urcode;
+} ndrxpy_fanout_t;
+
+/* Give up the open calls without TPNOTIME: cancelled, TPETIME. Returns
+   the number of calls still open (TPNOTIME ones). */
+static Py_ssize_t fanout_expire(ndrxpy_fanout_t* calls, Py_ssize_t n) {
+    Py_ssize_t open = 0;
+    Py_ssize_t i;
+
+    for (i = 0; i < n; i++) {
+	if (calls[i].cd <= 0 || calls[i].done) {
+	    continue;
+	}
+	if (calls[i].flags & TPNOTIME) {
+	    open++;
+	    continue;
+	}
+	tpcancel(calls[i].cd);
+	calls[i].err = TPETIME;
+	calls[i].done = 1;
+    }
+
+    return open;
+}
+
+/* Collect the replies of the issued calls, without the GIL. Replies are
+   taken with a blocking tpgetrply(TPGETANY) in the order they arrive and
+   matched by cd; the receive buffer is swapped with the request buffer of
+   the call, which is reused for the next receive. With a deadline each
+   receive is bounded by the time left (tpsblktime(TPBLK_NEXT), whole
+   seconds), at the deadline or on TPETIME the calls without TPNOTIME are
+   cancelled, the TPNOTIME ones are still waited for. Replies of other
+   tpacall()s of the thread taken meanwhile are dropped. */
+static void fanout_collect(ndrxpy_fanout_t* calls, Py_ssize_t n, int timeout) {
+    struct timespec start, now;
+    char* rcv = NULL;
+    Py_ssize_t open = 0;
+    Py_ssize_t i;
+
+    for (i = 0; i < n; i++) {
+	if (calls[i].cd > 0) {
+	    open++;
+	}
+    }
+
+    if (0 == open) {
+	return;
+    }
+
+    /* Buffer type will be changed by tpgetrply() if necessary */
+    if ((rcv = tpalloc("UBF", NULL, 1024)) == NULL) {
+	int err = tperrno;
+
+	for (i = 0; i < n; i++) {
+	    if (calls[i].cd > 0) {
+		tpcancel(calls[i].cd);
+		calls[i].err = err;
+	    }
+	}
+	return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while (open > 0) {
+	long flags = TPGETANY | TPNOTIME;
+	long len = 0;
+	int cd = 0;
+	int rc;
+	int err = 0;
+
+	/* the ATMI timeout or the deadline applies while a call without
+	   TPNOTIME is open */
+	for (i = 0; i < n; i++) {
+	    if (calls[i].cd > 0 && !calls[i].done && !(calls[i].flags & TPNOTIME)) {
+		flags &= ~TPNOTIME;
+		break;
+	    }
+	}
+
+	if (timeout > 0 && !(flags & TPNOTIME)) {
+	    long left_ms;
+
+	    clock_gettime(CLOCK_MONOTONIC, &now);
+	    left_ms = timeout * 1000L - ((now.tv_sec - start.tv_sec) * 1000L +
+					 (now.tv_nsec - start.tv_nsec) / 1000000L);
+	    if (left_ms <= 0) {
+		open = fanout_expire(calls, n);
+		continue;
+	    }
+	    tpsblktime((int)((left_ms + 999) / 1000), TPBLK_NEXT);
+	}
+
+	if ((rc = tpgetrply(&cd, &rcv, &len, flags)) < 0) {
+	    err = tperrno;
+	}
+
+	for (i = 0; i < n; i++) {
+	    if (cd > 0 && calls[i].cd == cd && !calls[i].done) {
+		break;
+	    }
+	}
+
+	if (i < n) {
+	    char* req = calls[i].buf;
+
+	    /* the reply, also on service failure */
+	    calls[i].buf = rcv;
+	    calls[i].len = len;
+	    calls[i].err = err;
+	    calls[i].urcode = tpurcode;
+	    calls[i].done = 1;
+	    open--;
+
+	    ubf_free_ptrs(req);
+	    rcv = req;
+	    if (NULL == rcv && (rcv = tpalloc("UBF", NULL, 1024)) == NULL) {
+		err = tperrno;
+		for (i = 0; i < n; i++) {
+		    if (calls[i].cd > 0 && !calls[i].done) {
+			tpcancel(calls[i].cd);
+			calls[i].err = err;
+			calls[i].done = 1;
+		    }
+		}
+		return;
+	    }
+	} else if (rc >= 0 || cd > 0) {
+	    NDRX_LOG(log_warn, "tpcall_many(): dropping reply of foreign cd %d", cd);
+	    ubf_free_ptrs(rcv);
+	} else if (TPETIME == err) {
+	    open = fanout_expire(calls, n);
+	} else {
+	    NDRX_LOG(log_error, "tpcall_many(): tpgetrply(): %d - %s", err, tpstrerror(err));
+	    for (i = 0; i < n; i++) {
+		if (calls[i].cd > 0 && !calls[i].done) {
+		    tpcancel(calls[i].cd);
+		    calls[i].err = err;
+		    calls[i].done = 1;
+		}
+	    }
+	    open = 0;
+	}
+    }
+
+    ubf_tpfree(rcv);
+}
+
+static PyObject* ndrxpy_tpcall_many(PyObject* self, PyObject* arg, PyObject* kw) {
+    static char *kwlist[] = {"calls", "timeout", NULL};
+    PyObject* result = NULL;
+    PyObject* calls_py = NULL;
+    PyObject* seq = NULL;
+    ndrxpy_fanout_t* calls = NULL;
+    Py_ssize_t n = 0;
+    Py_ssize_t i;
+    int timeout = 0;
+
+    if (!PyArg_ParseTupleAndKeywords(arg, kw, "O|i", kwlist, &calls_py, &timeout)) {
+	goto leave_func;
+    }
+
+    if ((seq = PySequence_Fast(calls_py, "tpcall_many(): calls must be a sequence")) == NULL) {
+	goto leave_func;
+    }
+    n = PySequence_Fast_GET_SIZE(seq);
+
+    if ((calls = (ndrxpy_fanout_t*)PyMem_Malloc(sizeof(ndrxpy_fanout_t) * (n ? n : 1))) == NULL) {
+	PyErr_NoMemory();
+	goto leave_func;
+    }
+    memset(calls, 0, sizeof(ndrxpy_fanout_t) * (n ? n : 1));
+
+    /* convert everything up front, nothing is sent if one request is bad */
+    for (i = 0; i < n; i++) {
+	PyObject* item = PySequence_Fast_GET_ITEM(seq, i);
+	char* service_name = NULL;
+	PyObject* input_py = NULL;
+
+	if (!PyArg_ParseTuple(item, "sO|l", &service_name, &input_py, &calls[i].flags)) {
+	    goto leave_func;
+	}
+
+	if (strlen(service_name) > MAX_SVC_NAME_LEN) {
+	    char tmp[200] = "";
+	    sprintf(tmp, "tpcall_many(): Service name length too long in call %d", (int)i);
+	    PyErr_SetString(PyExc_RuntimeError, tmp);
+	    goto leave_func;
+	}
+	strcpy(calls[i].svc, service_name);
+
+	if ((calls[i].buf = transform_py_to_ndrx(input_py, &calls[i].len)) == NULL) {
+	    goto leave_func;
+	}
+    }
+
+    NDRXPY_LOG(log_debug, "tpcall_many(): %d calls, timeout %d", (int)n, timeout);
+
+    Py_BEGIN_ALLOW_THREADS
+
+    for (i = 0; i < n; i++) {
+	if ((calls[i].cd = tpacall(calls[i].svc, calls[i].buf, calls[i].len,
+				   calls[i].flags & ~TPNOREPLY)) < 0) {
+	    calls[i].err = tperrno;
+	}
+    }
+
+    fanout_collect(calls, n, timeout);
+
+    Py_END_ALLOW_THREADS
+
+    if ((result = PyList_New(n)) == NULL) {
+	goto leave_func;
+    }
+
+    for (i = 0; i < n; i++) {
+	PyObject* data = NULL;
+	PyObject* item = NULL;
+
+	/* the service may have replied with data on failure too */
+	if (NULL != calls[i].buf && calls[i].cd > 0 &&
+	    (0 == calls[i].err || TPESVCFAIL == calls[i].err)) {
+	    if ((data = transform_ndrxpy_to_py(&calls[i].buf, calls[i].len, _convflags)) == NULL) {
+		Py_CLEAR(result);
+		goto leave_func;
+	    }
+	} else {
+	    Py_INCREF(Py_None);
+	    data = Py_None;
+	}
+
+	item = Py_BuildValue("(ilN)", calls[i].err, calls[i].urcode, data);
+	if (NULL == item) {
+	    Py_CLEAR(result);
+	    goto leave_func;
+	}
+	PyList_SET_ITEM(result, i, item);
+    }
+
+ leave_func:
+    if (calls) {
+	for (i = 0; i < n; i++) {
+	    if (calls[i].buf) ubf_tpfree(calls[i].buf);
+	}
+	PyMem_Free(calls);
+    }
+    Py_XDECREF(seq);
     return result;
 }
 
@@ -698,14 +1259,13 @@ ndrxpy_tpgetrply(PyObject * self, PyObject * args)
 static PyObject *
 ndrxpy_tpforward(PyObject * self, PyObject * args)
 {
-    NDRX_LOG(log_debug, "call ndrxpy_tpforward()");
-    PyObject_Print(args, stdout, 0);
+    NDRXPY_LOG(log_debug, "call ndrxpy_tpforward()");
 
     if (PyArg_ParseTuple(args, "sO", &_forward_service, &_forward_pydata)  < 0) {
 	return NULL;
     }
 
-    NDRX_LOG(log_debug, "forward to %s", _forward_service);
+    NDRXPY_LOG(log_debug, "forward to %s", _forward_service);
 
     Py_INCREF(_forward_pydata); 
     _forward++;
@@ -730,6 +1290,7 @@ ndrxpy_tpconnect(PyObject * self, PyObject * args)
     char* ndrxbuf = NULL;
     
     int handle = -1;
+    long inlen = 0;
     long flags = 0;
 
     if (PyArg_ParseTuple(args, "OO|O", &service, &input, &flags_py) < 0) {
@@ -753,22 +1314,24 @@ ndrxpy_tpconnect(PyObject * self, PyObject * args)
 	goto leave_func;
     }
 
-    if ((ndrxbuf = transform_py_to_ndrx(input)) == NULL) {
+    if ((ndrxbuf = transform_py_to_ndrx(input, &inlen)) == NULL) {
 	goto leave_func;
     }
        
     /* int tpconnect(char *svc, char *data, long len, long flags) */
 
-    if ((handle = tpconnect(service_name, ndrxbuf, 0, flags)) < 0) {
+    NDRXPY_NOGIL(handle = tpconnect(service_name, ndrxbuf, inlen, flags));
+    if (handle < 0) {
 	char tmp[200] = "";
 	sprintf(tmp, "tpconnect(): %d - %s", tperrno, tpstrerror(tperrno));
 	PyErr_SetString(PyExc_RuntimeError, tmp);
 	goto leave_func;
     }
+    replysize_call(handle, service_name);
     result = Py_BuildValue("l", (long)handle);
 
  leave_func:
-    if (ndrxbuf) tpfree(ndrxbuf);
+    if (ndrxbuf) ubf_tpfree(ndrxbuf);
     return result;
 }
 
@@ -794,7 +1357,8 @@ ndrxpy_tpdiscon(PyObject * self, PyObject * args)
     
     /* int tpdiscon(int cd) */
 
-    if ((handle = tpdiscon(handle)) < 0) {
+    NDRXPY_NOGIL(handle = tpdiscon(handle));
+    if (handle < 0) {
 	char tmp[200] = "";
 	sprintf(tmp, "tpdiscon(%lu): %d - %s", handle, tperrno, tpstrerror(tperrno));
 	PyErr_SetString(PyExc_RuntimeError, tmp);
@@ -821,6 +1385,7 @@ ndrxpy_tpsend(PyObject * self, PyObject * args)
     char* ndrxbuf = NULL;
     long revent = 0;
     int handle = -1;
+    long inlen = 0;
     long flags = 0;
     int ret = -1;
 
@@ -840,12 +1405,13 @@ ndrxpy_tpsend(PyObject * self, PyObject * args)
 	}
     }
 
-    if ((ndrxbuf = transform_py_to_ndrx(input)) == NULL) {
+    if ((ndrxbuf = transform_py_to_ndrx(input, &inlen)) == NULL) {
 	goto leave_func;
     }
  
     /* int tpsend(int cd, char *data, long len, long flags, long *revent) */
-    if ((ret = tpsend(handle, ndrxbuf, 0, flags, &revent)) < 0) {
+    NDRXPY_NOGIL(ret = tpsend(handle, ndrxbuf, inlen, flags, &revent));
+    if (ret < 0) {
 	if (tperrno != TPEEVENT) {
 	    char tmp[200] = "";
 	    sprintf(tmp, "tpsend(): %d - %s, revent = %lu", tperrno, tpstrerror(tperrno), revent);
@@ -857,7 +1423,7 @@ ndrxpy_tpsend(PyObject * self, PyObject * args)
     result = Py_BuildValue("l", (long)revent);
 
  leave_func:
-    if (ndrxbuf) tpfree(ndrxbuf);
+    if (ndrxbuf) ubf_tpfree(ndrxbuf);
     return result;
 }
 
@@ -896,19 +1462,15 @@ ndrxpy_tprecv(PyObject * self, PyObject * args)
 	}
     }
 
-    /* Buffer type will be changed by tprecv() if necessary */
-    if ((ndrxbuf = tpalloc("UBF", NULL, NDRXBUFSIZE)) == NULL) {
-	NDRX_LOG(log_error, "tpalloc(): %d - %s", tperrno, tpstrerror(tperrno));
-	goto leave_func;
-    }
-    
-    if (Binit((UBFH*)ndrxbuf, NDRXBUFSIZE) < 0) {
-	NDRX_LOG(log_error, "Binit(): %s", Bstrerror(Berror));
+    /* Buffer type will be changed by tprecv() if necessary, the size
+       follows the messages the service sent recently */
+    if ((ndrxbuf = bufpool_get("UBF", replysize_hint(handle))) == NULL) {
 	goto leave_func;
     }
 
     /*    int tprecv(int cd, char **data, long *len, long flags, long *revent) */
-    if ((ret = tprecv(handle, &ndrxbuf, &len, flags, &revent)) < 0) {
+    NDRXPY_NOGIL(ret = tprecv(handle, &ndrxbuf, &len, flags, &revent));
+    if (ret < 0) {
 	char tmp[200] = "";
 	if (tperrno != TPEEVENT) {
 	    sprintf(tmp, "tprecv(): %d - %s", tperrno, tpstrerror(tperrno));
@@ -924,7 +1486,8 @@ ndrxpy_tprecv(PyObject * self, PyObject * args)
        TPEV_SVCFAIL, and TPEV_SENDONLY events. Valid events for tprecv() are as follows. */
 
     if ((revent & ( TPEV_SVCSUCC | TPEV_SVCFAIL | TPEV_SENDONLY))) {
-	if ((len > 0) && (result = transform_ndrxpy_to_py(ndrxbuf)) == NULL) {
+	replysize_note(handle, ndrxbuf, len);
+	if ((len > 0) && (result = transform_ndrxpy_to_py(&ndrxbuf, len, _convflags)) == NULL) {
 	    goto leave_func;
 	}
     }
@@ -936,7 +1499,7 @@ ndrxpy_tprecv(PyObject * self, PyObject * args)
 	PyTuple_SetItem(res_tuple, 1, PyLong_FromLong(revent));
 
  leave_func:
-    if (ndrxbuf) tpfree(ndrxbuf);
+    if (ndrxbuf) bufpool_put(ndrxbuf);
     return res_tuple;
 }
 
@@ -950,7 +1513,7 @@ static PyObject* ndrxpy_tpopen(PyObject* self, PyObject* arg) {
 
     int ret      = -1;
     
-    ret = tpopen();
+    NDRXPY_NOGIL(ret = tpopen());
     if (ret == -1) {
 	char tmp[200] = "";
 	sprintf(tmp, "tpopen(): %d - %s", tperrno, tpstrerror(tperrno));
@@ -972,7 +1535,7 @@ static PyObject* ndrxpy_tpclose(PyObject* self, PyObject* arg) {
     PyObject * result         = NULL;
     int ret      = -1;
 
-    ret = tpclose();
+    NDRXPY_NOGIL(ret = tpclose());
     if (ret < 0) {
 	char tmp[200] = "";
 	sprintf(tmp, "tpclose(): %d -  %s", tperrno, tpstrerror(tperrno));
@@ -1031,7 +1594,7 @@ static PyObject* ndrxpy_tpbegin(PyObject* self, PyObject* arg) {
 	goto leave_func;
     }
     
-    ret = tpbegin(timeout, flags);
+    NDRXPY_NOGIL(ret = tpbegin(timeout, flags));
     if (ret < 0) {
 	sprintf(tmp, "tpbegin(%lu): %d - %s", timeout, tperrno, tpstrerror(tperrno));
 	PyErr_SetString(PyExc_RuntimeError, tmp);
@@ -1071,7 +1634,7 @@ static PyObject* ndrxpy_tpcommit(PyObject* self, PyObject* arg) {
 	}
     }
 
-    ret = tpcommit(flags);
+    NDRXPY_NOGIL(ret = tpcommit(flags));
     if (ret < 0) {
 	char tmp[200] = "";
 	sprintf(tmp, "tpcommit(): %d: %s", tperrno, tpstrerror(tperrno));
@@ -1109,7 +1672,7 @@ static PyObject* ndrxpy_tpabort(PyObject* self, PyObject* arg) {
 	}
     }
 
-    ret = tpabort(flags);
+    NDRXPY_NOGIL(ret = tpabort(flags));
     if (ret < 0) {
 	char tmp[200] = "";
 	sprintf(tmp, "tpabort(): %d - %s", tperrno, tpstrerror(tperrno));
@@ -1150,7 +1713,7 @@ static PyObject* ndrxpy_tpsuspend(PyObject* self, PyObject* arg) {
 	}
     }
 
-    ret = tpsuspend(&tranid_binrep, flags);
+    NDRXPY_NOGIL(ret = tpsuspend(&tranid_binrep, flags));
     if (ret < 0) {
 	char tmp[200] = "";
 	sprintf(tmp, "tpsuspend(): %d - %s", tperrno, tpstrerror(tperrno));
@@ -1202,7 +1765,7 @@ static PyObject* ndrxpy_tpresume(PyObject* self, PyObject* arg) {
     }
     
     
-    ret = tpresume(&tranid_binrep, flags);
+    NDRXPY_NOGIL(ret = tpresume(&tranid_binrep, flags));
     if (ret < 0) {
 	char tmp[200] = "";
 	sprintf(tmp, "tpresume(): %d -  %s", tperrno, tpstrerror(tperrno));
@@ -1243,6 +1806,7 @@ static PyObject* ndrxpy_tpgetlev(PyObject* self, PyObject* arg) {
 static PyObject * 
 ndrxpy_tpinit(PyObject * self, PyObject * args)
 {
+    int rc = -1;
     PyObject * result = NULL;
     PyObject * input = NULL;
     TPINIT* ndrxbuf = NULL;
@@ -1336,7 +1900,8 @@ ndrxpy_tpinit(PyObject * self, PyObject * args)
 		    ndrxbuf->usrname, ndrxbuf->cltname);
 
 	
-    if (tpinit(ndrxbuf) < 0) {
+    NDRXPY_NOGIL(rc = tpinit(ndrxbuf));
+    if (rc < 0) {
 	char tmp[200] = "";
 	sprintf(tmp, "tpinit(): %d - %s", tperrno, tpstrerror(tperrno));
 	PyErr_SetString(PyExc_RuntimeError, tmp);
@@ -1348,7 +1913,7 @@ ndrxpy_tpinit(PyObject * self, PyObject * args)
     }
     
  leave_func:
-    if (ndrxbuf) tpfree((char*)ndrxbuf);
+    if (ndrxbuf) ubf_tpfree((char*)ndrxbuf);
     return result;
 }
 
@@ -1441,7 +2006,7 @@ static PyObject* ndrxpy_tpchkauth(PyObject* self, PyObject* arg) {
     PyObject * result         = NULL;
     int ret = -1;
 
-    ret = tpchkauth() ;
+    NDRXPY_NOGIL(ret = tpchkauth());
     if (ret < 0) {
 	char tmp[200] = "";
 	sprintf(tmp, "tpchkauth(): %d - %s", tperrno, tpstrerror(tperrno));
@@ -1460,9 +2025,11 @@ static PyObject* ndrxpy_tpchkauth(PyObject* self, PyObject* arg) {
 static PyObject * 
 ndrxpy_tpterm(PyObject * self, PyObject * args)
 {
+    int rc = -1;
     PyObject * result = NULL;
     
-    if (tpterm() < 0) {
+    NDRXPY_NOGIL(rc = tpterm());
+    if (rc < 0) {
 	char tmp[200] = "";
 	sprintf(tmp, "tpterm(): %d - %s", tperrno, tpstrerror(tperrno));
 	PyErr_SetString(PyExc_RuntimeError, tmp);
@@ -1481,11 +2048,20 @@ ndrxpy_tpterm(PyObject * self, PyObject * args)
 #ifndef NDRXWS
 /* {{{ ndrxpy_tpadvertise() */
 
-static PyObject* ndrxpy_tpadvertise(PyObject* self, PyObject* arg) {
+static PyObject* ndrxpy_tpadvertise(PyObject* self, PyObject* arg, PyObject* kw) {
     int idx = 0;
     char * service_name   = NULL;
     char * method_name    = NULL;
+    long convflags        = -1;
+    PyObject * fields_py  = NULL;
+    BFLDID * fields       = NULL;
+    PyObject * filter_py  = NULL;
+    PyObject * filter     = NULL;
+    char * filter_forward = NULL;
+    PyObject * schema     = NULL;
     PyObject * result     = NULL;
+    static char *kwlist[] = {"svc", "method", "convflags", "fields", 
+			     "filter", "filter_forward", "schema", NULL};
 
 
     if (!_server_is_running) {
@@ -1493,7 +2069,33 @@ static PyObject* ndrxpy_tpadvertise(PyObject* self, PyObject* arg) {
 	goto leave_func;
     }
 
-    if (!PyArg_ParseTuple(arg, "s|s", &service_name, &method_name)) {
+    if (!PyArg_ParseTupleAndKeywords(arg, kw, "s|zlOOzO", kwlist, 
+				     &service_name, &method_name, &convflags,
+				     &fields_py, &filter_py, &filter_forward, &schema)) {
+	goto leave_func;
+    }
+
+    if (schema == Py_None) {
+	schema = NULL;
+    } else if (schema && !Schema_Check(schema)) {
+	PyErr_SetString(PyExc_TypeError, "tpadvertise(): schema must be atmi.Schema");
+	goto leave_func;
+    }
+
+    if (filter_forward && strlen(filter_forward) >= MAX_SVC_NAME_LEN) {
+	PyErr_SetString(PyExc_RuntimeError, "tpadvertise(): Filter forward service name length too long");
+	goto leave_func;
+    }
+
+    /* UBF requests not matching the expression don't reach Python */
+    if (filter_py && filter_py != Py_None && 
+	(filter = boolexpr_get(filter_py)) == NULL) {
+	goto leave_func;
+    }
+
+    /* decode only these fields of the UBF requests */
+    if (fields_py && fields_py != Py_None && 
+	(fields = parse_fields(fields_py)) == NULL) {
 	goto leave_func;
     }
 
@@ -1527,9 +2129,22 @@ static PyObject* ndrxpy_tpadvertise(PyObject* self, PyObject* arg) {
 	strncpy(_registered_services[idx].method, service_name, MAX_SVC_NAME_LEN);
     }
     strcpy(_registered_services[idx].name, service_name);
+    _registered_services[idx].convflags = convflags;
+    free(_registered_services[idx].fields);
+    _registered_services[idx].fields = fields;
+    fields = NULL;
+    Py_XDECREF(_registered_services[idx].filter);
+    _registered_services[idx].filter = filter;
+    filter = NULL;
+    strcpy(_registered_services[idx].filter_forward, filter_forward ? filter_forward : "");
+    Py_XINCREF(schema);
+    Py_XDECREF(_registered_services[idx].schema);
+    _registered_services[idx].schema = schema;
 
     result = PyInt_FromLong((long)tpurcode);
  leave_func:
+    free(fields);
+    Py_XDECREF(filter);
     return result; 
 }
 
@@ -1579,6 +2194,7 @@ static PyObject* ndrxpy_tpunadvertise(PyObject* self, PyObject* arg) {
 static PyObject * 
 ndrxpy_tpenqueue(PyObject * self, PyObject * args)
 {
+    int rc = -1;
     PyObject * result   = NULL;
     PyObject * flags_py = NULL;
     PyObject * data     = NULL;
@@ -1588,6 +2204,7 @@ ndrxpy_tpenqueue(PyObject * self, PyObject * args)
     char* queue_name  = NULL;
     char* ndrxbuf      = NULL;
     
+    long inlen = 0;
     long flags = 0;
 
     TPQCTL qctl;
@@ -1701,11 +2318,12 @@ ndrxpy_tpenqueue(PyObject * self, PyObject * args)
 	}
     } 
 
-    if ((ndrxbuf = transform_py_to_ndrx(data)) == NULL) {
+    if ((ndrxbuf = transform_py_to_ndrx(data, &inlen)) == NULL) {
 	goto leave_func;
     }
 
-    if (tpenqueue(queue_space, queue_name, &qctl, ndrxbuf, 0, flags) < 0) {
+    NDRXPY_NOGIL(rc = tpenqueue(queue_space, queue_name, &qctl, ndrxbuf, inlen, flags));
+    if (rc < 0) {
 	char tmp[200] = "";
 
 	/* 
@@ -1740,7 +2358,7 @@ ndrxpy_tpenqueue(PyObject * self, PyObject * args)
 
     result = Py_BuildValue("l", 1);
  leave_func:
-    if (ndrxbuf) tpfree(ndrxbuf);
+    if (ndrxbuf) ubf_tpfree(ndrxbuf);
     return result;
 }
 
@@ -1750,6 +2368,7 @@ ndrxpy_tpenqueue(PyObject * self, PyObject * args)
 static PyObject * 
 ndrxpy_tpdequeue(PyObject * self, PyObject * args)
 {
+    int rc = -1;
     PyObject * result   = NULL;
     PyObject * flags_py = NULL;
     PyObject * qctl_obj = NULL;
@@ -1820,7 +2439,8 @@ ndrxpy_tpdequeue(PyObject * self, PyObject * args)
 
 	    NDRX_LOG(log_debug, "%d : before tpdequeue", __LINE__);
 
-    if (tpdequeue(queue_space, queue_name, &qctl, &ndrxbuf, &outlen, flags) < 0) {
+    NDRXPY_NOGIL(rc = tpdequeue(queue_space, queue_name, &qctl, &ndrxbuf, &outlen, flags));
+    if (rc < 0) {
 	char tmp[200] = "";
 
 	if (tperrno == TPEDIAGNOSTIC) {
@@ -1843,7 +2463,7 @@ ndrxpy_tpdequeue(PyObject * self, PyObject * args)
 	    NDRX_LOG(log_debug, "%d : after tpdequeue", __LINE__);
 
 
-    if ((result = transform_ndrxpy_to_py(ndrxbuf)) == NULL) {
+    if ((result = transform_ndrxpy_to_py(&ndrxbuf, outlen, _convflags)) == NULL) {
 
 	    NDRX_LOG(log_debug, "%d : transform_ndrxpy_to_py failed ", __LINE__);
 
@@ -1903,7 +2523,7 @@ ndrxpy_tpdequeue(PyObject * self, PyObject * args)
      
  leave_func:
     if (item) { Py_DECREF(item); }
-    if (ndrxbuf) { tpfree(ndrxbuf); }
+    if (ndrxbuf) { ubf_tpfree(ndrxbuf); }
     return result;
 }
 
@@ -1912,6 +2532,7 @@ ndrxpy_tpdequeue(PyObject * self, PyObject * args)
 /* {{{ ndrxpy_tppost() */
 
 static PyObject* ndrxpy_tppost(PyObject* self, PyObject* arg) {
+    int rc = -1;
 
     PyObject * result   = NULL;
     PyObject * flags_py = NULL;
@@ -1921,6 +2542,7 @@ static PyObject* ndrxpy_tppost(PyObject* self, PyObject* arg) {
     char * event_name = NULL;
     char* ndrxbuf = NULL;
 
+    long inlen = 0;
     long flags = 0;
 
 
@@ -1938,11 +2560,12 @@ static PyObject* ndrxpy_tppost(PyObject* self, PyObject* arg) {
 	PyErr_SetString(PyExc_RuntimeError, "tppost(): No event name given");
 	goto leave_func;
     }
-    if ((ndrxbuf = transform_py_to_ndrx(evdata)) == NULL) {
+    if ((ndrxbuf = transform_py_to_ndrx(evdata, &inlen)) == NULL) {
 	goto leave_func;
     }
 
-    if (tppost(event_name, ndrxbuf, 0, flags) < 0) {
+    NDRXPY_NOGIL(rc = tppost(event_name, ndrxbuf, inlen, flags));
+    if (rc < 0) {
 	char tmp[200] = "";
 	sprintf(tmp, "tppost(): %d - %s", tperrno, tpstrerror(tperrno));
 	PyErr_SetString(PyExc_RuntimeError, tmp);
@@ -1952,7 +2575,7 @@ static PyObject* ndrxpy_tppost(PyObject* self, PyObject* arg) {
     result = PyInt_FromLong((long)tpurcode);
 
  leave_func:
-    if (ndrxbuf) tpfree(ndrxbuf);
+    if (ndrxbuf) ubf_tpfree(ndrxbuf);
 
     return result; 
 }
@@ -2006,7 +2629,8 @@ static PyObject* ndrxpy_tpsubscribe(PyObject* self, PyObject* arg) {
 
     NDRX_LOG(log_debug, "calling tpsubscribe(%s, %s, ctl, %d)\n", evt_expr, evt_filter, flags);
     
-    if ((handle = tpsubscribe(evt_expr, evt_filter, &ctl, flags)) < 0) {
+    NDRXPY_NOGIL(handle = tpsubscribe(evt_expr, evt_filter, &ctl, flags));
+    if (handle < 0) {
 	char tmp[200] = "";
 	sprintf(tmp, "tpsubscribe(): %d - %s", tperrno, tpstrerror(tperrno));
 	PyErr_SetString(PyExc_RuntimeError, tmp);
@@ -2026,6 +2650,7 @@ static PyObject* ndrxpy_tpsubscribe(PyObject* self, PyObject* arg) {
 /* {{{ ndrxpy_tpunsubscribe() */
 
 static PyObject* ndrxpy_tpunsubscribe(PyObject* self, PyObject* arg) {
+    int rc = -1;
 
     PyObject * result   = NULL;
     PyObject * flags_py = NULL;
@@ -2045,7 +2670,8 @@ static PyObject* ndrxpy_tpunsubscribe(PyObject* self, PyObject* arg) {
 	}
     }
 
-    if (tpunsubscribe(handle, flags) < 0) {
+    NDRXPY_NOGIL(rc = tpunsubscribe(handle, flags));
+    if (rc < 0) {
 	char tmp[200] = "";
 	sprintf(tmp, "tpunsubscribe(): %d - %s", tperrno, tpstrerror(tperrno));
 	PyErr_SetString(PyExc_RuntimeError, tmp);
@@ -2062,6 +2688,7 @@ static PyObject* ndrxpy_tpunsubscribe(PyObject* self, PyObject* arg) {
 /* {{{ ndrxpy_tpnotify() */
 
 static PyObject* ndrxpy_tpnotify(PyObject* self, PyObject* arg) {
+    int rc = -1;
 
     PyObject * result      = NULL;
     PyObject * clientid_py = NULL;
@@ -2070,6 +2697,7 @@ static PyObject* ndrxpy_tpnotify(PyObject* self, PyObject* arg) {
 
     char * clientid_string = NULL;
     char * ndrxbuf          = NULL;
+    long inlen             = 0;
     long flags             = 0;
 
     CLIENTID clientid;
@@ -2093,7 +2721,7 @@ static PyObject* ndrxpy_tpnotify(PyObject* self, PyObject* arg) {
 	goto leave_func;
     }
     
-    if ((ndrxbuf = transform_py_to_ndrx(data_py)) == NULL) {
+    if ((ndrxbuf = transform_py_to_ndrx(data_py, &inlen)) == NULL) {
 	goto leave_func;
     }
 
@@ -2104,7 +2732,8 @@ static PyObject* ndrxpy_tpnotify(PyObject* self, PyObject* arg) {
 	goto leave_func;
     }
     
-    if(tpnotify(&clientid, ndrxbuf, 0, flags) == -1) {
+    NDRXPY_NOGIL(rc = tpnotify(&clientid, ndrxbuf, inlen, flags));
+    if (rc == -1) {
 	char tmp[200] = "";
 	sprintf(tmp, "tpnotify(): %d - %s", tperrno, tpstrerror(tperrno));
 	PyErr_SetString(PyExc_RuntimeError, tmp);
@@ -2114,7 +2743,7 @@ static PyObject* ndrxpy_tpnotify(PyObject* self, PyObject* arg) {
     result = PyInt_FromLong((long)tpurcode);
 
  leave_func:
-    if (ndrxbuf) tpfree(ndrxbuf);
+    if (ndrxbuf) ubf_tpfree(ndrxbuf);
     return result; 
 }
 
@@ -2135,6 +2764,7 @@ static PyObject* ndrxpy_tpbroadcast(PyObject* self, PyObject* arg) {
     char * cltname = NULL;
     char * ndrxbuf  = NULL;
 
+    long inlen     = 0;
     long flags     = 0;
 
     if (!PyArg_ParseTuple(arg, "OOOO|O", &lmid_py, &usrname_py, &cltname_py, &data_py, &flags_py)) {
@@ -2181,12 +2811,12 @@ static PyObject* ndrxpy_tpbroadcast(PyObject* self, PyObject* arg) {
 	}
     }
 	
-    if ((ndrxbuf = transform_py_to_ndrx(data_py)) == NULL) {
+    if ((ndrxbuf = transform_py_to_ndrx(data_py, &inlen)) == NULL) {
 	goto leave_func;
     }
 
 /* EnduroX - not supported.
-    if (tpbroadcast(lmid, usrname, cltname, tuxbuf,  0, flags) == -1) {
+    if (tpbroadcast(lmid, usrname, cltname, tuxbuf,  inlen, flags) == -1) {
 	char tmp[200] = "";
 	sprintf(tmp, "tpbroadcast(): %d - %s", tperrno, tpstrerror(tperrno));
 	PyErr_SetString(PyExc_RuntimeError, tmp);
@@ -2197,7 +2827,7 @@ static PyObject* ndrxpy_tpbroadcast(PyObject* self, PyObject* arg) {
     result = PyInt_FromLong((long)tpurcode);
 
  leave_func:
-    if (ndrxbuf) tpfree(ndrxbuf);
+    if (ndrxbuf) ubf_tpfree(ndrxbuf);
     return result; 
 }
 
@@ -2211,23 +2841,35 @@ static PyObject* ndrxpy_tpbroadcast(PyObject* self, PyObject* arg) {
 static void unsol_handler(char* ndrxbuf, long len, long flags) {
 
     PyObject* data_py = NULL;
+    PyObject* ret = NULL;
+    PyGILState_STATE gstate;
+
+    /* Obtain the Global Interpreter Lock (the handler may run from
+       tpchkunsol() or any ATMI call made without it) */
+    gstate = PyGILState_Ensure();
 
-    /* Transform the ENDUROX buffer to a Python type (len is not needed
-       (only STRING/UBF is supported), flags is not supported by ENDUROX */
+    /* Transform the ENDUROX buffer to a Python type (len is needed for
+       CARRAY only), flags is not supported by ENDUROX */
 
-    if ((data_py = transform_ndrxpy_to_py(ndrxbuf)) == NULL) {
+    /* buffer belongs to the ATMI library, no proxy */
+    if ((data_py = transform_ndrxpy_to_py(&ndrxbuf, len,
+		    _convflags & ~(NDRXPY_CONV_PROXY|NDRXPY_CONV_INPLACE))) == NULL) {
 	NDRX_LOG(log_debug, "transform_ndrxpy_to_py failed");
 	goto leave_func;
     }
 
-    /* Obtain the Global Interpreter Lock */
-    PyGILState_STATE gstate;
-    gstate = PyGILState_Ensure();
-    PyObject_CallFunction (py_unsol_handler, "O", data_py); 
-    /* Release the thread. No Python API allowed beyond this point. */
-    PyGILState_Release(gstate);    
+    if ((ret = PyObject_CallFunction(py_unsol_handler, "O", data_py)) == NULL) {
+	PyErr_Print();
+    }
 
  leave_func:
+    Py_XDECREF(ret);
+    Py_XDECREF(data_py);
+    if (PyErr_Occurred()) {
+	PyErr_Print();
+    }
+    /* Release the thread. No Python API allowed beyond this point. */
+    PyGILState_Release(gstate);    
     
     return;
 }
@@ -2268,7 +2910,6 @@ static PyObject* ndrxpy_tpsetunsol(PyObject* self, PyObject* arg) {
 	
     } else {
 	sprintf(tmp, "tpsetunsol(): No callable object given");
-	PyObject_Print(py_unsol_handler, stdout, 0);
 	PyErr_SetString(PyExc_RuntimeError, tmp);
 	goto leave_func;
     }
@@ -2291,7 +2932,8 @@ static PyObject* ndrxpy_tpchkunsol(PyObject* self, PyObject* arg) {
     PyObject * result = NULL;
     long num_evts = 0;
 
-    if ((num_evts = tpchkunsol()) == -1) {
+    NDRXPY_NOGIL(num_evts = tpchkunsol());
+    if (num_evts == -1) {
 	char tmp[200] = "";
 	sprintf(tmp, "tpchkunsol(): %d - %s", tperrno, tpstrerror(tperrno));
 	PyErr_SetString(PyExc_RuntimeError, tmp);
@@ -2379,26 +3021,491 @@ static PyObject* ndrxpy_set_tpurcode(PyObject* self, PyObject* arg) {
 }
 
 /* }}} */
-#ifndef NDRXWS
-/* {{{ ndrx_mainloop() */
+/* {{{ ndrxpy_get_convflags() */
 
-static PyObject * 
-ndrx_mainloop(PyObject * self, PyObject * args)
-{
-    int i;
-    int argc;
-    char* argv[30];
+static PyObject* ndrxpy_get_convflags(PyObject* self, PyObject* arg) {
+    return PyInt_FromLong(_convflags);
+}
 
-    PyObject*  argv_obj  = NULL;    
-    PyObject*  xa_switch = NULL;    
-    
-    /* 1st arg: argv, 2nd arg: server object, 3rd arg
-       (optional): XA function switch */
+/* }}} */
+/* {{{ ndrxpy_set_convflags() */
 
-    if (!PyArg_ParseTuple(args, "OOO|O", 
-			  &argv_obj, &_server_obj, &_reloader_function, &xa_switch)) {
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+  Set the default CONV_* flags, used for the replies received by this
+  process and for the services advertised without own convflags.
 
-	NDRX_LOG(log_debug, "parseTuple 2");
+  PyObject* ndrxpy_set_convflags   Return: previous flags
+  +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+static PyObject* ndrxpy_set_convflags(PyObject* self, PyObject* arg) {
+    long old = _convflags;
+    long flags = 0;
+
+    if (!PyArg_ParseTuple(arg, "l", &flags)) {
+	return NULL;
+    }
+    _convflags = flags;
+
+    return PyInt_FromLong(old);
+}
+
+/* }}} */
+
+/* {{{ ndrxpy_set_hotlog() */
+
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+  Switch the logging on the buffer conversion and service dispatch paths
+  on or off (errors are logged regardless). Has no effect when built with
+  NDRXPY_NO_HOTLOG
+
+  PyObject* ndrxpy_set_hotlog   Return: previous setting
+
+  int on                        0 - off, else on                          :IN
+  +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+static PyObject* ndrxpy_set_hotlog(PyObject* self, PyObject* arg) {
+    int old = ndrxpy_hotlog;
+    int on = 0;
+
+    if (!PyArg_ParseTuple(arg, "i", &on)) {
+	return NULL;
+    }
+    ndrxpy_hotlog = on ? 1 : 0;
+
+    return PyBool_FromLong(old);
+}
+
+/* }}} */
+
+/* {{{ py_ubf_buffer() */
+
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+  Get UBF buffer to read from UBF data given to module functions: the
+  proxy buffer is used as is (with pending changes stored), dictionary
+  and Record are converted to temporary buffer returned in *tmp (free it
+  with ubf_tpfree())
+
+  UBFH* py_ubf_buffer     Return: buffer or NULL on error (Python
+                          exception set)
+
+  PyObject* data          dict, UbfProxy or Record                        :IN
+
+  UBFH** tmp              temporary buffer or NULL                        :OUT
+  +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+static UBFH* py_ubf_buffer(PyObject* data, UBFH** tmp) {
+    *tmp = NULL;
+
+    if (UbfProxy_Check(data)) {
+	/* read the proxy buffer itself, no copy */
+	if (ubfproxy_sync(data) < 0) {
+	    return NULL;
+	}
+	return ubfproxy_buffer(data);
+    } else if (PyDict_Check(data)) {
+	return (*tmp = dict_to_ubf(data));
+    } else if (Record_Check(data)) {
+	return (*tmp = record_to_ubf(data));
+    }
+
+    PyErr_SetString(PyExc_TypeError, "dict, UbfProxy or Record expected");
+    return NULL;
+}
+
+/* }}} */
+
+/* {{{ ndrxpy_tpjsontoubf() */
+
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+  Convert JSON document to UBF (tpjsontoubf()), returned as dictionary or
+  as UbfProxy, following the conversion flags (module flags if not given)
+
+  PyObject* ndrxpy_tpjsontoubf   Return: dict or UbfProxy
+
+  char* json                     JSON document (str or JsonStr)            :IN
+
+  long convflags                 CONV_* flags                              :IN
+  +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+static PyObject* ndrxpy_tpjsontoubf(PyObject* self, PyObject* arg) {
+    char* json = NULL;
+    long flags = _convflags;
+    char* ndrxbuf = NULL;
+    PyObject* result = NULL;
+
+    if (!PyArg_ParseTuple(arg, "s|l", &json, &flags)) {
+	goto leave_func;
+    }
+
+    if ((ndrxbuf = (char*)json_to_ubf(json)) == NULL) {
+	goto leave_func;
+    }
+
+    result = transform_ndrxpy_to_py(&ndrxbuf, 0, flags & ~NDRXPY_CONV_BORROW);
+
+ leave_func:
+    if (ndrxbuf) ubf_tpfree(ndrxbuf);
+    return result;
+}
+
+/* }}} */
+
+/* {{{ ndrxpy_tpubftojson() */
+
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+  Convert UBF data to JSON document (tpubftojson())
+
+  PyObject* ndrxpy_tpubftojson   Return: JsonStr
+
+  PyObject* data                 dict, UbfProxy or Record                  :IN
+  +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+static PyObject* ndrxpy_tpubftojson(PyObject* self, PyObject* arg) {
+    PyObject* data = NULL;
+    UBFH* ubf = NULL;
+    UBFH* tmp = NULL;
+    PyObject* result = NULL;
+
+    if (!PyArg_ParseTuple(arg, "O", &data) ||
+	    (ubf = py_ubf_buffer(data, &tmp)) == NULL) {
+	goto leave_func;
+    }
+
+    result = ubf_to_json(ubf);
+
+ leave_func:
+    if (tmp) ubf_tpfree((char*)tmp);
+    return result;
+}
+
+/* }}} */
+
+/* {{{ ndrxpy_ubf_aggr() */
+
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+  Common part of ubf_sum(), ubf_min(), ubf_max(), ubf_count(), ubf_mean()
+  and ubf_distinct(): reduce all occurrences of the field in C
+
+  PyObject* ndrxpy_ubf_aggr   Return: number (None for min/max/mean of
+                              a missing field)
+
+  PyObject* data              dict, UbfProxy or Record                    :IN
+
+  char* field                 field name                                  :IN
+
+  int op                      NDRXPY_AGGR_* reduction                    :IN
+  +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+static PyObject* ndrxpy_ubf_aggr(PyObject* arg, int op) {
+    PyObject* data = NULL;
+    PyObject* field = NULL;
+    UBFH* ubf = NULL;
+    UBFH* tmp = NULL;
+    BFLDID id;
+    PyObject* result = NULL;
+
+    if (!PyArg_ParseTuple(arg, "OS", &data, &field) ||
+	    (id = ubf_fldid(field)) == BBADFLDID ||
+	    (ubf = py_ubf_buffer(data, &tmp)) == NULL) {
+	goto leave_func;
+    }
+
+    result = ubf_aggregate(ubf, id, op);
+
+ leave_func:
+    if (tmp) ubf_tpfree((char*)tmp);
+    return result;
+}
+
+static PyObject* ndrxpy_ubf_sum(PyObject* self, PyObject* arg) {
+    return ndrxpy_ubf_aggr(arg, NDRXPY_AGGR_SUM);
+}
+
+static PyObject* ndrxpy_ubf_min(PyObject* self, PyObject* arg) {
+    return ndrxpy_ubf_aggr(arg, NDRXPY_AGGR_MIN);
+}
+
+static PyObject* ndrxpy_ubf_max(PyObject* self, PyObject* arg) {
+    return ndrxpy_ubf_aggr(arg, NDRXPY_AGGR_MAX);
+}
+
+static PyObject* ndrxpy_ubf_count(PyObject* self, PyObject* arg) {
+    return ndrxpy_ubf_aggr(arg, NDRXPY_AGGR_COUNT);
+}
+
+static PyObject* ndrxpy_ubf_mean(PyObject* self, PyObject* arg) {
+    return ndrxpy_ubf_aggr(arg, NDRXPY_AGGR_MEAN);
+}
+
+static PyObject* ndrxpy_ubf_distinct(PyObject* self, PyObject* arg) {
+    return ndrxpy_ubf_aggr(arg, NDRXPY_AGGR_DISTINCT);
+}
+
+/* }}} */
+
+/* {{{ ndrxpy_ubf_tobytes() */
+
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+  Serialize UBF data to the libubf binary form (Bwrite()), keeping the
+  field types; a proxy is written from its own buffer
+
+  PyObject* ndrxpy_ubf_tobytes   Return: str
+
+  PyObject* data                 dict, UbfProxy or Record                  :IN
+  +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+static PyObject* ndrxpy_ubf_tobytes(PyObject* self, PyObject* arg) {
+    PyObject* data = NULL;
+    UBFH* ubf = NULL;
+    UBFH* tmp = NULL;
+    PyObject* result = NULL;
+
+    if (!PyArg_ParseTuple(arg, "O", &data) ||
+	    (ubf = py_ubf_buffer(data, &tmp)) == NULL) {
+	goto leave_func;
+    }
+
+    result = ubf_to_bytes(ubf);
+
+ leave_func:
+    if (tmp) ubf_tpfree((char*)tmp);
+    return result;
+}
+
+/* }}} */
+
+/* {{{ ndrxpy_ubf_frombytes() */
+
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+  Restore UBF data serialized by ubf_tobytes() (Bread()), returned as
+  dictionary or as UbfProxy, following the conversion flags (module flags
+  if not given)
+
+  PyObject* ndrxpy_ubf_frombytes   Return: dict or UbfProxy
+
+  char* data                       binary UBF form                         :IN
+
+  long convflags                   CONV_* flags                            :IN
+  +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+static PyObject* ndrxpy_ubf_frombytes(PyObject* self, PyObject* arg) {
+    char* data = NULL;
+    Py_ssize_t len = 0;
+    long flags = _convflags;
+    char* ndrxbuf = NULL;
+    PyObject* result = NULL;
+
+    if (!PyArg_ParseTuple(arg, "s#|l", &data, &len, &flags)) {
+	goto leave_func;
+    }
+
+    if ((ndrxbuf = (char*)ubf_from_bytes(data, len)) == NULL) {
+	goto leave_func;
+    }
+
+    result = transform_ndrxpy_to_py(&ndrxbuf, 0, flags & ~NDRXPY_CONV_BORROW);
+
+ leave_func:
+    if (ndrxbuf) ubf_tpfree(ndrxbuf);
+    return result;
+}
+
+/* }}} */
+
+/* {{{ ndrxpy_ubf_to_dict() */
+
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+  Convert UBF data to dictionary. With `into', the given dictionary is
+  refilled instead of making a new one: the occurrence lists of fields
+  present again are reused, other fields removed
+
+  PyObject* ndrxpy_ubf_to_dict   Return: dictionary (`into' if given)
+
+  PyObject* data                 UbfProxy, dict or Record                  :IN
+
+  PyObject* into                 dictionary to refill                      :IN
+
+  long convflags                 CONV_SCALAR / CONV_ARRAY flags (module
+                                 flags if not given)                       :IN
+  +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+static PyObject* ndrxpy_ubf_to_dict(PyObject* self, PyObject* arg, PyObject* kw) {
+    PyObject* data = NULL;
+    PyObject* into = NULL;
+    long flags = _convflags;
+    UBFH* ubf = NULL;
+    UBFH* tmp = NULL;
+    PyObject* result = NULL;
+    static char *kwlist[] = {"data", "into", "convflags", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(arg, kw, "O|O!l", kwlist,
+				     &data, &PyDict_Type, &into, &flags) ||
+	    (ubf = py_ubf_buffer(data, &tmp)) == NULL) {
+	goto leave_func;
+    }
+
+    if (NULL == into) {
+	result = ubf_to_dict(ubf, flags);
+    } else if (ubf_to_dict_into(ubf, into, flags) == 0) {
+	Py_INCREF(into);
+	result = into;
+    }
+
+ leave_func:
+    if (tmp) ubf_tpfree((char*)tmp);
+    return result;
+}
+
+/* }}} */
+
+/* {{{ ndrxpy_dict_to_ubf() */
+
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+  Convert dictionary to UBF buffer held by UbfProxy. With `into', the
+  buffer of the given (writable) proxy is reinitialized and refilled,
+  keeping its allocation
+
+  PyObject* ndrxpy_dict_to_ubf   Return: UbfProxy (`into' if given)
+
+  PyObject* data                 dictionary                                :IN
+
+  PyObject* into                 UbfProxy to refill                        :IN
+  +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+static PyObject* ndrxpy_dict_to_ubf(PyObject* self, PyObject* arg, PyObject* kw) {
+    PyObject* data = NULL;
+    PyObject* into = NULL;
+    UBFH* ubf = NULL;
+    PyObject* result = NULL;
+    static char *kwlist[] = {"data", "into", NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(arg, kw, "O!|O!", kwlist,
+				     &PyDict_Type, &data, &UbfProxy_Type, &into)) {
+	goto leave_func;
+    }
+
+    if (NULL != into) {
+	if (ubfproxy_refill(into, data) == 0) {
+	    Py_INCREF(into);
+	    result = into;
+	}
+    } else if ((ubf = dict_to_ubf(data)) != NULL &&
+	       (result = ubfproxy_new(ubf, 1, 1)) == NULL) {
+	ubf_tpfree((char*)ubf);
+    }
+
+ leave_func:
+    return result;
+}
+
+/* }}} */
+
+/* {{{ ndrxpy_rows_to_ubf() */
+
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+  Convert a result set (list of row dictionaries) to UBF, row i being
+  occurrence i of the fields
+
+  PyObject* ndrxpy_rows_to_ubf   Return: UbfProxy
+
+  PyObject* rows                 list of dictionaries                      :IN
+  +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+static PyObject* ndrxpy_rows_to_ubf(PyObject* self, PyObject* arg) {
+    PyObject* rows = NULL;
+    UBFH* ubf = NULL;
+    PyObject* result = NULL;
+
+    if (!PyArg_ParseTuple(arg, "O", &rows) ||
+	    (ubf = rows_to_ubf(rows)) == NULL) {
+	goto leave_func;
+    }
+
+    if ((result = ubfproxy_new(ubf, 1, 1)) == NULL) {
+	ubf_tpfree((char*)ubf);
+    }
+
+ leave_func:
+    return result;
+}
+
+/* }}} */
+
+/* {{{ ndrxpy_ubf_to_rows() */
+
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+  Convert UBF holding a result set (occurrence i of the fields is row i)
+  to list of row dictionaries
+
+  PyObject* ndrxpy_ubf_to_rows   Return: list of dictionaries
+
+  PyObject* data                 UbfProxy, dict or Record                  :IN
+
+  long convflags                 CONV_* flags for nested buffers (module
+                                 flags if not given)                       :IN
+  +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+static PyObject* ndrxpy_ubf_to_rows(PyObject* self, PyObject* arg) {
+    PyObject* data = NULL;
+    long flags = _convflags;
+    UBFH* ubf = NULL;
+    UBFH* tmp = NULL;
+    PyObject* result = NULL;
+
+    if (!PyArg_ParseTuple(arg, "O|l", &data, &flags) ||
+	    (ubf = py_ubf_buffer(data, &tmp)) == NULL) {
+	goto leave_func;
+    }
+
+    result = ubf_to_rows(ubf, flags);
+
+ leave_func:
+    if (tmp) ubf_tpfree((char*)tmp);
+    return result;
+}
+
+/* }}} */
+/* {{{ ndrxpy_fldcache_preload() */
+
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+  Load all fields from the field tables (FIELDTBLS/FLDTBLDIR) into the
+  field name cache used by the UBF converters. Without this the cache is
+  filled lazily as fields are seen.
+
+  PyObject* ndrxpy_fldcache_preload   Return: number of fields loaded
+  +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+
+static PyObject* ndrxpy_fldcache_preload(PyObject* self, PyObject* arg) {
+    int loaded;
+
+    if ((loaded = ubf_fldcache_preload()) < 0) {
+	return NULL;
+    }
+
+    return PyInt_FromLong((long)loaded);
+}
+
+/* }}} */
+#ifndef NDRXWS
+/* {{{ ndrx_mainloop() */
+
+static PyObject * 
+ndrx_mainloop(PyObject * self, PyObject * args)
+{
+    int i;
+    int argc;
+    char* argv[30];
+
+    PyObject*  argv_obj  = NULL;    
+    PyObject*  xa_switch = NULL;    
+    
+    /* 1st arg: argv, 2nd arg: server object, 3rd arg
+       (optional): XA function switch */
+
+    if (!PyArg_ParseTuple(args, "OOO|O", 
+			  &argv_obj, &_server_obj, &_reloader_function, &xa_switch)) {
+
+	NDRX_LOG(log_debug, "parseTuple 2");
 
 	return NULL;
     }
@@ -2471,6 +3578,35 @@ PyMODINIT_FUNC
     /* Add some symbolic constants to the module */
     d = PyModule_GetDict(m);
 
+    /* Types */
+    if (PyType_Ready(&UbfProxy_Type) == 0) {
+	Py_INCREF(&UbfProxy_Type);
+	PyModule_AddObject(m, "UbfProxy", (PyObject*)&UbfProxy_Type);
+    }
+    if (PyType_Ready(&BoolExpr_Type) == 0) {
+	Py_INCREF(&BoolExpr_Type);
+	PyModule_AddObject(m, "BoolExpr", (PyObject*)&BoolExpr_Type);
+    }
+    if (PyType_Ready(&Schema_Type) == 0 && PyType_Ready(&Record_Type) == 0) {
+	Py_INCREF(&Schema_Type);
+	PyModule_AddObject(m, "Schema", (PyObject*)&Schema_Type);
+	Py_INCREF(&Record_Type);
+	PyModule_AddObject(m, "Record", (PyObject*)&Record_Type);
+    }
+    /* UbfProxy pickles as ubf_frombytes(data, CONV_PROXY) */
+    if ((ubfproxy_unpickler = PyDict_GetItemString(d, "ubf_frombytes")) != NULL) {
+	Py_INCREF(ubfproxy_unpickler);
+    }
+    if (PyType_Ready(&PreparedCall_Type) == 0) {
+	Py_INCREF(&PreparedCall_Type);
+	PyModule_AddObject(m, "PreparedCall", (PyObject*)&PreparedCall_Type);
+    }
+    JsonStr_Type.tp_base = &PyString_Type;
+    if (PyType_Ready(&JsonStr_Type) == 0) {
+	Py_INCREF(&JsonStr_Type);
+	PyModule_AddObject(m, "JsonStr", (PyObject*)&JsonStr_Type);
+    }
+
     /* Exit codes */
 
     ins(d, "TPSUCCESS",	TPSUCCESS);
@@ -2612,6 +3748,28 @@ PyMODINIT_FUNC
     ins(d, "log_debug", log_debug);
     ins(d, "log_dump", log_dump);
 
+    /* Buffer conversion flags (set_convflags(), tpadvertise()) */
+
+    ins(d, "CONV_PROXY", NDRXPY_CONV_PROXY);
+    ins(d, "CONV_INPLACE", NDRXPY_CONV_INPLACE);
+    ins(d, "CONV_SCALAR", NDRXPY_CONV_SCALAR);
+    ins(d, "CONV_JSON", NDRXPY_CONV_JSON);
+    ins(d, "CONV_ARRAY", NDRXPY_CONV_ARRAY);
+
+    /* ATMI calls release the GIL, services and handlers take it back */
+    PyEval_InitThreads();
+
+    /* init the Enduro/X logger here, the hot paths only check the level */
+    NDRX_LOG(log_debug, "atmi module loaded");
+    if (getenv("NDRXPY_HOTLOG") && !atoi(getenv("NDRXPY_HOTLOG"))) {
+	ndrxpy_hotlog = 0;
+    }
+
+    /* Optionally resolve all field names at import time */
+    if (getenv("NDRXPY_FLDCACHE_PRELOAD") && ubf_fldcache_preload() < 0) {
+	PyErr_Print();
+    }
+
     /* Check for errors */
     if (PyErr_Occurred())
 	Py_FatalError("can't initialize module atmi");
@@ -2627,15 +3785,20 @@ int
 tpsvrinit(int argc, char *argv[])
 {
     PyObject * argv_py = NULL;
+    PyObject * ret = NULL;
+    PyGILState_STATE gstate = PyGILState_Ensure();
+
     /* build a list from char* argv[] */
     
     argv_py = makeargvobject(argc, argv);
 
     _server_is_running++;
 
-    (void)PyObject_CallMethod(_server_obj, "init", "O", argv_py);
+    ret = PyObject_CallMethod(_server_obj, "init", "O", argv_py);
+    Py_XDECREF(ret);
     Py_DECREF(argv_py);
 
+    PyGILState_Release(gstate);
     return(0);
 }
 
@@ -2645,8 +3808,14 @@ tpsvrinit(int argc, char *argv[])
 void
 tpsvrdone(void)
 {
+    PyObject * ret = NULL;
+    PyGILState_STATE gstate = PyGILState_Ensure();
+
     _server_is_running--;
-    (void)PyObject_CallMethod(_server_obj, "cleanup", NULL);
+    ret = PyObject_CallMethod(_server_obj, "cleanup", NULL);
+    Py_XDECREF(ret);
+
+    PyGILState_Release(gstate);
     return;
 }
 
@@ -2699,7 +3868,22 @@ void endurox_dispatch(TPSVCINFO * rqst) {
     PyObject *py_appkey = NULL;
     char cltid_string[TPCONVMAXSTR+1] = "";
     char* res_ndrx = NULL;
+    long res_len = 0;
     long tp_returncode = TPSUCCESS;
+    long convflags = _convflags;
+    BFLDID* fields = NULL;
+    PyObject* schema = NULL;
+    char buffer_type[100] = "";
+    PyGILState_STATE gstate;
+
+/* tpreturn() / tpforward() may not come back here, the GIL goes first */
+#define DISPATCH_RETURN(rval, data, len) \
+    do { PyGILState_Release(gstate); tpreturn(rval, _set_tpurcode, data, len, 0); return; } while (0)
+#define DISPATCH_FORWARD(svc, data, len) \
+    do { PyGILState_Release(gstate); tpforward(svc, data, len, 0); return; } while (0)
+
+    /* ndrx_main() runs without the GIL */
+    gstate = PyGILState_Ensure();
 
     /* reset user return code */
     _set_tpurcode = 0;
@@ -2779,7 +3963,7 @@ void endurox_dispatch(TPSVCINFO * rqst) {
     
     if (tpconvert(cltid_string, (char*)(rqst->cltid).clientdata, TPTOSTRING | TPCONVCLTID) == -1) {
 	NDRX_LOG(log_debug, "tpconvert(bin_clientid -> string_clientid): %d - %s", tperrno, tpstrerror(tperrno));
-	tpreturn(TPFAIL, _set_tpurcode, 0, 0L, 0);
+	DISPATCH_RETURN(TPFAIL, 0, 0L);
     }
 
     py_cltid = PyString_FromString(cltid_string);
@@ -2793,24 +3977,74 @@ void endurox_dispatch(TPSVCINFO * rqst) {
 
     if ((idx=find_entry(rqst->name)) < 0) {
 	NDRX_LOG(log_debug, "unknown servicename");
-	tpreturn(TPFAIL, _set_tpurcode, 0, 0L, 0);
+	DISPATCH_RETURN(TPFAIL, 0, 0L);
+    }
+
+    if (_registered_services[idx].convflags != -1) {
+	convflags = _registered_services[idx].convflags;
     }
 
-    NDRX_LOG(log_debug, "transforming buffer ...");
+    /* gate in C: requests not matching the filter are not converted */
+    if (_registered_services[idx].filter &&
+	tptypes(rqst->data, buffer_type, NULL) >= 0 && !strcmp(buffer_type, "UBF")) {
+	int match = boolexpr_eval(_registered_services[idx].filter, (UBFH*)rqst->data);
 
-    if ((obj = transform_ndrxpy_to_py(rqst->data)) == NULL) {
+	if (match < 0) {
+	    NDRX_LOG(log_error, "Cannot evaluate filter of %s", rqst->name);
+	    PyErr_Clear();
+	    DISPATCH_RETURN(TPFAIL, 0, 0L);
+	} else if (!match) {
+	    if (_registered_services[idx].filter_forward[0]) {
+		NDRXPY_LOG(log_debug, "filter of %s not matched, forward to %s", 
+			 rqst->name, _registered_services[idx].filter_forward);
+		DISPATCH_FORWARD(_registered_services[idx].filter_forward, rqst->data, rqst->len);
+	    } else {
+		NDRXPY_LOG(log_debug, "filter of %s not matched", rqst->name);
+		DISPATCH_RETURN(TPFAIL, rqst->data, rqst->len);
+	    }
+	}
+    }
+
+    NDRXPY_LOG(log_debug, "transforming buffer ...");
+
+    /* schema: decode the planned fields into a record, the rest stays in
+       the request buffer */
+    if (_registered_services[idx].schema &&
+	!(convflags & (NDRXPY_CONV_PROXY|NDRXPY_CONV_INPLACE)) &&
+	tptypes(rqst->data, buffer_type, NULL) >= 0 && !strcmp(buffer_type, "UBF")) {
+	schema = _registered_services[idx].schema;
+	obj = ubf_to_record(schema, (UBFH*)rqst->data);
+    }
+    /* projection: decode only the fields the service asked for, the rest
+       stays in the request buffer (proxies convert on demand anyway) */
+    else if (_registered_services[idx].fields &&
+	!(convflags & (NDRXPY_CONV_PROXY|NDRXPY_CONV_INPLACE)) &&
+	tptypes(rqst->data, buffer_type, NULL) >= 0 && !strcmp(buffer_type, "UBF")) {
+	fields = _registered_services[idx].fields;
+	obj = ubf_fields_to_dict((UBFH*)rqst->data, fields, convflags);
+    }
+    /* rqst->data is released by tpreturn(), proxy only borrows it */
+    else {
+	obj = transform_ndrxpy_to_py(&rqst->data, rqst->len, convflags | NDRXPY_CONV_BORROW);
+    }
+
+    if (obj == NULL) {
 	NDRX_LOG(log_debug, "Cannot convert input buffer to a Python type");
-	tpreturn(TPFAIL, _set_tpurcode, 0, 0L, 0);
+	DISPATCH_RETURN(TPFAIL, 0, 0L);
     }
     
-    NDRX_LOG(log_debug, "calling %s/%s ... (_server_obj=%p)", 
+    NDRXPY_LOG(log_debug, "calling %s/%s ... (_server_obj=%p)", 
             _registered_services[idx].name, _registered_services[idx].method,
             _server_obj);
     
     if (!(pydata = PyObject_CallMethod(_server_obj, _registered_services[idx].method, "O", obj))) {
+	if (UbfProxy_Check(obj)) {
+	    rqst->data = (char*)((UbfProxyObject*)obj)->ubf;
+	    ubfproxy_release(obj);
+	}
 	Py_XDECREF(obj);
 	NDRX_LOG(log_debug, "Error calling method %s ...", _registered_services[idx].method);
-	tpreturn(TPFAIL, _set_tpurcode, 0, 0L, 0);
+	DISPATCH_RETURN(TPFAIL, 0, 0L);
     }
 
     /* _forward was maybe set by the server's method by calling
@@ -2819,16 +4053,15 @@ void endurox_dispatch(TPSVCINFO * rqst) {
 
     if (_forward) {
 
-	NDRX_LOG(log_debug, "endurox_dispatch: forward: %s ->", _forward_service);
-	PyObject_Print(_forward_pydata, stdout, 0);
-	NDRX_LOG(log_debug, "");
+	NDRXPY_LOG(log_debug, "endurox_dispatch: forward: %s", _forward_service);
+	NDRXPY_DUMP_PY("forward data:", _forward_pydata);
 
 	Py_XDECREF(pydata); /* don't need the data returned from function call (should be NULL) */
 	pydata = _forward_pydata; /* reference count was incremented by ndrxpy_tpforward() */
     }
 
 
-    NDRX_LOG(log_debug, "returning ...");
+    NDRXPY_LOG(log_debug, "returning ...");
 
 
     /* If the method call returned an integer, transform it to a Ndrx return
@@ -2853,27 +4086,63 @@ void endurox_dispatch(TPSVCINFO * rqst) {
 	    tp_returncode = TPEXIT;
 	}
     } else {
+	if (pydata == obj && (convflags & NDRXPY_CONV_INPLACE) && UbfProxy_Check(obj)) {
+	    /* request buffer changed in place, return it as is */
+	    if (ubfproxy_sync(obj) < 0) {
+		NDRX_LOG(log_error, "Cannot store changes to the request buffer");
+		rqst->data = (char*)((UbfProxyObject*)obj)->ubf;
+		ubfproxy_release(obj);
+		Py_XDECREF(obj);
+		Py_XDECREF(pydata);
+		DISPATCH_RETURN(TPFAIL, 0, 0L);
+	    }
+	    res_ndrx = (char*)((UbfProxyObject*)obj)->ubf;
+	}
+	else if (pydata == obj && (fields || schema)) {
+	    /* projected request dict / record, put it back to the full buffer */
+	    if ((schema ? record_merge_ubf((UBFH**)&rqst->data, obj) :
+		 dict_merge_ubf((UBFH**)&rqst->data, obj, fields)) < 0) {
+		NDRX_LOG(log_error, "Cannot store changes to the request buffer");
+		Py_XDECREF(obj);
+		Py_XDECREF(pydata);
+		DISPATCH_RETURN(TPFAIL, 0, 0L);
+	    }
+	    res_ndrx = rqst->data;
+	}
 	/* transform..() takes String or Dict */
-	if ((res_ndrx = transform_py_to_ndrx(pydata)) == NULL) {
+	else if ((res_ndrx = transform_py_to_ndrx(pydata, &res_len)) == NULL) {
+	    if (UbfProxy_Check(obj)) {
+		rqst->data = (char*)((UbfProxyObject*)obj)->ubf;
+		ubfproxy_release(obj);
+	    }
 	    Py_XDECREF(obj);
 	    Py_XDECREF(pydata);
-	    tpreturn(TPFAIL, _set_tpurcode, 0, 0L, 0);
+	    DISPATCH_RETURN(TPFAIL, 0, 0L);
 	}
     }
 
+    /* the service may keep a reference, but the buffer is gone after
+       tpreturn(). A writable request buffer may have been reallocated. */
+    if (UbfProxy_Check(obj)) {
+	rqst->data = (char*)((UbfProxyObject*)obj)->ubf;
+	ubfproxy_release(obj);
+    }
 
     Py_XDECREF(obj);
     Py_XDECREF(pydata);
     
     if (_forward) {
 
-	NDRX_LOG(log_debug, "call tpforward(%s, ...)\n", _forward_service);
+	NDRXPY_LOG(log_debug, "call tpforward(%s, ...)", _forward_service);
 
-	tpforward(_forward_service, (char*)res_ndrx, 0L, 0);
+	DISPATCH_FORWARD(_forward_service, (char*)res_ndrx, res_len);
     } else {
-	NDRX_LOG(log_debug, "call tpreturn(TPSUCCESS, ...)");
-	tpreturn(tp_returncode, _set_tpurcode, (char*)res_ndrx, 0L, 0);
+	NDRXPY_LOG(log_debug, "call tpreturn(TPSUCCESS, ...)");
+	DISPATCH_RETURN(tp_returncode, (char*)res_ndrx, res_len);
     }
+
+#undef DISPATCH_RETURN
+#undef DISPATCH_FORWARD
 }
 
 /* }}} */
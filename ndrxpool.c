@@ -0,0 +1,286 @@
+/*
+   This file implements the reply buffer pool. tpgetrply() and tprecv()
+   need a buffer to receive into; instead of a fresh NDRXBUFSIZE buffer
+   for every call, buffers are taken from a pool kept by power of two
+   size class, and given back after the reply is converted.
+   Only UBF buffers are pooled: that is the type the receive buffers are
+   allocated as, buffers libatmi retyped for the reply are freed.
+
+   The size asked for comes from the replies the service gave recently:
+   the service of each call descriptor is remembered at tpacall() /
+   tpconnect(), and every reply updates the service's size estimate
+   (jumps up at once, decays slowly), so the buffer usually fits the reply
+   without libatmi having to reallocate it. Replies taken with TPGETANY,
+   whose service is not known up front, are sized by the estimate over
+   all replies.
+
+   All functions are called with the GIL held, which serializes access
+   to the pool and the tables between Python threads.
+
+   (c) 2017 Mavimax, SIA
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atmi.h>     /* ENDUROX Header File */
+#include <ubf.h>    /* ENDUROX Header File */
+
+#include <ndebug.h>
+#include <Python.h>
+
+#include "ndrxconvert.h"
+#include "ndrxpool.h"
+
+#define POOL_MINSHIFT	10	/* smallest class 1 KB */
+#define POOL_CLASSES	7	/* ... up to 64 KB */
+#define POOL_DEPTH	4	/* buffers kept per class */
+
+#define SVC_SLOTS	128	/* services tracked */
+#define CD_SLOTS	256	/* call descriptors mapped to services */
+
+static char* M_pool[POOL_CLASSES][POOL_DEPTH];
+static int M_poolcnt[POOL_CLASSES];
+
+typedef struct {
+	char name[XATMI_SERVICE_NAME_LENGTH+1];
+	long est;		/* reply size estimate, 0 - none yet */
+} svcsize_t;
+
+static svcsize_t M_svc[SVC_SLOTS];
+
+typedef struct {
+	int cd;
+	int svc;		/* index in M_svc */
+} cdsvc_t;
+
+static cdsvc_t M_cd[CD_SLOTS];
+
+/* estimate over the replies of all services */
+static svcsize_t M_any;
+
+/*
+ * Smallest size class holding `size' bytes, -1 if too big
+ */
+static int pool_class(long size)
+{
+	int i;
+
+	for (i = 0; i < POOL_CLASSES; i++)
+	{
+		if (size <= (1L << (POOL_MINSHIFT + i)))
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * Get buffer of the type with at least `size' bytes, UBF buffers from
+ * the pool if there is one, empty (Binit).
+ * Returns NULL with Python exception set on failure.
+ */
+char* bufpool_get(char* type, long size)
+{
+	int c = pool_class(size);
+	char* buf;
+
+	if (!strcmp(type, "UBF") && c >= 0)
+	{
+		size = 1L << (POOL_MINSHIFT + c);
+
+		if (M_poolcnt[c] > 0)
+		{
+			buf = M_pool[c][--M_poolcnt[c]];
+
+			if (Binit((UBFH*)buf, size) < 0)
+			{
+				char tmp[200] = "";
+				sprintf(tmp, "Binit(): %d - %s", Berror, Bstrerror(Berror));
+				PyErr_SetString(PyExc_RuntimeError, tmp);
+				tpfree(buf);
+				return NULL;
+			}
+			return buf;
+		}
+	}
+
+	if ((buf = tpalloc(type, NULL, size)) == NULL)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "tpalloc(%s, %ld): %d - %s", type, size, tperrno, tpstrerror(tperrno));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+	}
+
+	return buf;
+}
+
+/*
+ * Give the buffer back: kept in the pool if it is still UBF and its size
+ * is exactly a size class (libatmi may have reallocated or retyped it),
+ * else freed.
+ */
+void bufpool_put(char* buf)
+{
+	char type[16] = "";
+	long size;
+	int c;
+
+	if ((size = tptypes(buf, type, NULL)) < 0 ||
+		strcmp(type, "UBF") ||
+		(c = pool_class(size)) < 0 ||
+		size != (1L << (POOL_MINSHIFT + c)) ||
+		M_poolcnt[c] >= POOL_DEPTH)
+	{
+		ubf_tpfree(buf);
+		return;
+	}
+
+	if (ubf_free_ptrs(buf) < 0)
+	{
+		PyErr_Clear();
+		tpfree(buf);
+		return;
+	}
+
+	M_pool[c][M_poolcnt[c]++] = buf;
+}
+
+/*
+ * Slot of the service, taken over if the service is new
+ */
+static int svc_slot(char* svc)
+{
+	unsigned long h = 5381;
+	char* p;
+	int i;
+
+	for (p = svc; *p; p++)
+	{
+		h = h * 33 + (unsigned char)*p;
+	}
+
+	/* short linear probe, else the home slot is reused */
+	for (i = 0; i < 8; i++)
+	{
+		svcsize_t* s = &M_svc[(h + i) % SVC_SLOTS];
+
+		if (!strcmp(s->name, svc))
+		{
+			return (int)((h + i) % SVC_SLOTS);
+		}
+		if (EXEOS == s->name[0])
+		{
+			break;
+		}
+	}
+
+	if (8 == i)
+	{
+		i = 0;
+	}
+
+	i = (int)((h + i) % SVC_SLOTS);
+	strncpy(M_svc[i].name, svc, XATMI_SERVICE_NAME_LENGTH);
+	M_svc[i].name[XATMI_SERVICE_NAME_LENGTH] = EXEOS;
+	M_svc[i].est = 0;
+
+	return i;
+}
+
+/*
+ * Remember the service of a call / conversation descriptor
+ */
+void replysize_call(int cd, char* svc)
+{
+	cdsvc_t* e;
+
+	if (cd <= 0)
+	{
+		return;
+	}
+
+	e = &M_cd[cd % CD_SLOTS];
+	e->cd = cd;
+	e->svc = svc_slot(svc);
+}
+
+/*
+ * Service entry of the descriptor, NULL if unknown
+ */
+static svcsize_t* cd_svc(int cd)
+{
+	cdsvc_t* e;
+
+	if (cd <= 0)
+	{
+		return NULL;
+	}
+
+	e = &M_cd[cd % CD_SLOTS];
+
+	return (e->cd == cd) ? &M_svc[e->svc] : NULL;
+}
+
+/*
+ * Buffer size to receive the reply for the descriptor in: recent reply
+ * sizes of the service plus some headroom, NDRXBUFSIZE if not known yet.
+ * Descriptor 0 (TPGETANY) goes by the replies of all services.
+ */
+long replysize_hint(int cd)
+{
+	svcsize_t* s = (0 == cd) ? &M_any : cd_svc(cd);
+
+	if (NULL == s || 0 == s->est)
+	{
+		return NDRXBUFSIZE;
+	}
+
+	return s->est + s->est / 4;
+}
+
+/*
+ * Update size estimate with the reply size
+ */
+static void est_update(svcsize_t* s, long size)
+{
+	if (size > s->est)
+	{
+		s->est = size;
+	}
+	else
+	{
+		s->est -= (s->est - size) / 8;
+	}
+}
+
+/*
+ * Account the reply received for the descriptor
+ */
+void replysize_note(int cd, char* buf, long len)
+{
+	svcsize_t* s = cd_svc(cd);
+	char type[16] = "";
+	long size = len;
+
+	if (NULL == buf)
+	{
+		return;
+	}
+
+	if (tptypes(buf, type, NULL) >= 0 && !strcmp(type, "UBF"))
+	{
+		size = Bused((UBFH*)buf);
+	}
+
+	est_update(&M_any, size);
+
+	if (NULL != s)
+	{
+		est_update(s, size);
+		NDRXPY_LOG(log_debug, "reply size %ld for %s, estimate %ld", size, s->name, s->est);
+	}
+}
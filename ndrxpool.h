@@ -0,0 +1,26 @@
+/*
+   This file declares the reply buffer pool: UBF buffers kept by size
+   class for reuse, and the reply sizes seen per service, used
+   to size the buffers passed to tpgetrply() / tprecv().
+
+   (c) 2017 Mavimax, SIA
+
+
+*/
+
+
+#ifndef NDRXPOOL_H
+#define NDRXPOOL_H
+
+
+
+extern char* bufpool_get(char* type, long size);
+extern void bufpool_put(char* buf);
+
+extern void replysize_call(int cd, char* svc);
+extern long replysize_hint(int cd);
+extern void replysize_note(int cd, char* buf, long len);
+
+
+
+#endif /* NDRXPOOL_H */
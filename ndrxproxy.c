@@ -0,0 +1,832 @@
+/*
+   This file implements the atmi.UbfProxy type. It gives mapping access
+   (like the dictionary made by ubf_to_dict()) to a UBF buffer, but only
+   the fields actually looked up are converted to Python objects. The
+   converted fields are cached in the proxy.
+
+   Writable proxies store assigned fields straight into the buffer
+   (Bchg/Bdel, growing it with tprealloc). Occurrence lists handed out by
+   the proxy may be changed in place too, they are written back to the
+   buffer by ubfproxy_sync() before the buffer is sent anywhere. Only the
+   lists changed since conversion are written back, fields that were just
+   read are not encoded again.
+
+   (c) 2017 Mavimax, SIA
+
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include <atmi.h>     /* ENDUROX Header File */
+#include <ubf.h>    /* ENDUROX Header File */
+
+#include <ndebug.h>
+#include <Python.h>
+
+#include "ndrxconvert.h"
+#include "ndrxproxy.h"
+
+PyObject* ubfproxy_unpickler = NULL;
+
+/*
+ * Get the buffer of a proxy, raise exception if it was released already
+ * (e.g. request buffer after the service returned).
+ */
+UBFH* ubfproxy_buffer(PyObject* proxy)
+{
+	UbfProxyObject* self = (UbfProxyObject*)proxy;
+
+	if (NULL == self->ubf)
+	{
+		PyErr_SetString(PyExc_RuntimeError, "UbfProxy: UBF buffer is no longer available");
+	}
+
+	return self->ubf;
+}
+
+/*
+ * Make proxy for the buffer. If `owned' is set, the buffer is freed
+ * together with the proxy, otherwise the caller must release the proxy
+ * with ubfproxy_release() before freeing the buffer. Owned buffers are
+ * always writable.
+ */
+PyObject* ubfproxy_new(UBFH* ubf, int owned, int writable)
+{
+	UbfProxyObject* self;
+
+	if ((self = PyObject_New(UbfProxyObject, &UbfProxy_Type)) == NULL)
+	{
+		return NULL;
+	}
+
+	self->ubf = ubf;
+	self->owned = owned;
+	self->writable = owned || writable;
+
+	self->snap = NULL;
+
+	if ((self->cache = PyDict_New()) == NULL ||
+		(self->snap = PyDict_New()) == NULL)
+	{
+		self->owned = 0;
+		Py_DECREF(self);
+		return NULL;
+	}
+
+	return (PyObject*)self;
+}
+
+/*
+ * Detach the buffer from proxy. Already converted fields stay available.
+ */
+void ubfproxy_release(PyObject* proxy)
+{
+	UbfProxyObject* self = (UbfProxyObject*)proxy;
+
+	if (self->owned && self->ubf)
+	{
+		ubf_tpfree((char*)self->ubf);
+	}
+	self->ubf = NULL;
+	self->owned = 0;
+	self->writable = 0;
+}
+
+/*
+ * Was the cached occurrence list changed in place since it was converted:
+ * other length or other objects than in the snapshot. Mutable values
+ * (nested UBF as dict, CARRAY as bytearray, ...) may have changed
+ * inside, they count as changed.
+ */
+static int list_dirty(PyObject* list, PyObject* snap)
+{
+	Py_ssize_t i;
+
+	if (NULL == snap || !PyList_Check(list) ||
+		PyList_GET_SIZE(list) != PyTuple_GET_SIZE(snap))
+	{
+		return 1;
+	}
+
+	for (i = 0; i < PyList_GET_SIZE(list); i++)
+	{
+		PyObject* item = PyList_GET_ITEM(list, i);
+
+		if (item != PyTuple_GET_ITEM(snap, i) ||
+			PyDict_Check(item) || PyList_Check(item) ||
+			PyByteArray_Check(item) || UbfProxy_Check(item))
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Remember the occurrences of a cached field as converted.
+ * Returns -1 with Python exception set on failure.
+ */
+static int snap_set(UbfProxyObject* self, PyObject* key, PyObject* list)
+{
+	PyObject* snap;
+	int ret;
+
+	if ((snap = PySequence_Tuple(list)) == NULL)
+	{
+		return -1;
+	}
+	ret = PyDict_SetItem(self->snap, key, snap);
+	Py_DECREF(snap);
+
+	return ret;
+}
+
+/*
+ * Write the cached occurrence lists changed in place back to a writable
+ * buffer, the fields only read are left as they are.
+ * Returns -1 with Python exception set on failure.
+ */
+int ubfproxy_sync(PyObject* proxy)
+{
+	UbfProxyObject* self = (UbfProxyObject*)proxy;
+	Py_ssize_t pos = 0;
+	PyObject* key;
+	PyObject* list;
+
+	if (!self->writable || NULL == self->ubf)
+	{
+		return 0;
+	}
+
+	while (PyDict_Next(self->cache, &pos, &key, &list))
+	{
+		BFLDID id;
+
+		if (!list_dirty(list, PyDict_GetItem(self->snap, key)))
+		{
+			continue;
+		}
+
+		if ((id = ubf_fldid(key)) == BBADFLDID ||
+			ubf_set_field(&self->ubf, id, list) < 0 ||
+			snap_set(self, key, list) < 0)
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Copy the proxied buffer to a new UBF buffer (no Python conversion).
+ * Returns NULL with Python exception set on failure.
+ */
+UBFH* ubfproxy_copy(PyObject* proxy)
+{
+	UBFH* src;
+	UBFH* dst;
+	long size;
+
+	if (ubfproxy_sync(proxy) < 0 || (src = ubfproxy_buffer(proxy)) == NULL)
+	{
+		return NULL;
+	}
+
+	size = Bused(src);
+
+	if ((dst = (UBFH*)tpalloc("UBF", NULL, size)) == NULL)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "tpalloc(%ld): %d - %s", size, tperrno, tpstrerror(tperrno));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		return NULL;
+	}
+
+	if (Bcpy(dst, src) < 0)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "Bcpy(): %d - %s", Berror, Bstrerror(Berror));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		tpfree((char*)dst);
+		return NULL;
+	}
+
+	/* the copy is freed on its own */
+	if (ubf_own_ptrs(dst) < 0)
+	{
+		tpfree((char*)dst);
+		return NULL;
+	}
+
+	return dst;
+}
+
+/*
+ * List of field names present in the buffer
+ */
+static PyObject* ubfproxy_keys(UbfProxyObject* self)
+{
+	UBFH* ubf;
+	PyObject* keys;
+	BFLDID id = BFIRSTFLDID;
+	BFLDID prev = BBADFLDID;
+	BFLDOCC oc;
+	Bnext_state_t state;
+	int res;
+
+	if ((ubf = ubfproxy_buffer((PyObject*)self)) == NULL)
+	{
+		return NULL;
+	}
+
+	if ((keys = PyList_New(0)) == NULL)
+	{
+		return NULL;
+	}
+
+	/* occurrences of a field follow each other; own walk state, the
+	   buffer may be being walked already (nested UBF fields) */
+	while ((res = Bnext2(&state, ubf, &id, &oc, NULL, NULL, NULL)) > 0)
+	{
+		if (id != prev)
+		{
+			PyObject* name;
+
+			if ((name = ubf_fldname(id)) == NULL || PyList_Append(keys, name) < 0)
+			{
+				Py_DECREF(keys);
+				return NULL;
+			}
+			prev = id;
+		}
+	}
+
+	if (res < 0)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "Bnext2(): %d - %s", Berror, Bstrerror(Berror));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+		Py_DECREF(keys);
+		return NULL;
+	}
+
+	return keys;
+}
+
+/*
+ * Get field (list of occurrences), convert and cache it on first access.
+ * Returns new reference, NULL w/o exception if field is not present.
+ */
+static PyObject* ubfproxy_lookup(UbfProxyObject* self, PyObject* key)
+{
+	PyObject* list;
+	UBFH* ubf;
+	BFLDID id;
+
+	if ((list = PyDict_GetItem(self->cache, key)) != NULL)
+	{
+		Py_INCREF(list);
+		return list;
+	}
+
+	if ((ubf = ubfproxy_buffer((PyObject*)self)) == NULL)
+	{
+		return NULL;
+	}
+
+	if ((id = ubf_fldid(key)) == BBADFLDID)
+	{
+		/* not a field name: not in the buffer */
+		PyErr_Clear();
+		return NULL;
+	}
+
+	if (!Bpres(ubf, id, 0))
+	{
+		return NULL;
+	}
+
+	if ((list = ubf_field_to_list(ubf, id, 0)) == NULL)
+	{
+		return NULL;
+	}
+
+	if (PyDict_SetItem(self->cache, key, list) < 0 ||
+		(self->writable && snap_set(self, key, list) < 0))
+	{
+		Py_DECREF(list);
+		return NULL;
+	}
+
+	return list;
+}
+
+static PyObject* ubfproxy_subscript(UbfProxyObject* self, PyObject* key)
+{
+	PyObject* list = ubfproxy_lookup(self, key);
+
+	if (NULL == list && !PyErr_Occurred())
+	{
+		PyErr_SetObject(PyExc_KeyError, key);
+	}
+
+	return list;
+}
+
+/*
+ * proxy[key] = value: replace all occurrences of the field,
+ * del proxy[key]: remove the field
+ */
+static int ubfproxy_ass_subscript(UbfProxyObject* self, PyObject* key, PyObject* value)
+{
+	BFLDID id;
+
+	if (NULL == ubfproxy_buffer((PyObject*)self))
+	{
+		return -1;
+	}
+
+	if (!self->writable)
+	{
+		PyErr_SetString(PyExc_TypeError, "UbfProxy: buffer is read-only (see CONV_INPLACE)");
+		return -1;
+	}
+
+	if ((id = ubf_fldid(key)) == BBADFLDID)
+	{
+		return -1;
+	}
+
+	if ((PyDict_GetItem(self->cache, key) && PyDict_DelItem(self->cache, key) < 0) ||
+		(PyDict_GetItem(self->snap, key) && PyDict_DelItem(self->snap, key) < 0))
+	{
+		return -1;
+	}
+
+	if (NULL == value)
+	{
+		if (Bdelall(self->ubf, id) < 0)
+		{
+			if (BNOTPRES == Berror)
+			{
+				PyErr_SetObject(PyExc_KeyError, key);
+			}
+			else
+			{
+				char tmp[200] = "";
+				sprintf(tmp, "Bdelall(): %d - %s", Berror, Bstrerror(Berror));
+				PyErr_SetString(PyExc_RuntimeError, tmp);
+			}
+			return -1;
+		}
+		return 0;
+	}
+
+	return ubf_set_field(&self->ubf, id, value);
+}
+
+static PyObject* ubfproxy_update(UbfProxyObject* self, PyObject* dict)
+{
+	Py_ssize_t pos = 0;
+	PyObject* key;
+	PyObject* value;
+
+	if (!PyDict_Check(dict))
+	{
+		PyErr_SetString(PyExc_TypeError, "UbfProxy.update(): dictionary expected");
+		return NULL;
+	}
+
+	while (PyDict_Next(dict, &pos, &key, &value))
+	{
+		if (ubfproxy_ass_subscript(self, key, value) < 0)
+		{
+			return NULL;
+		}
+	}
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+/*
+ * Replace the whole content of the proxied buffer with the dictionary,
+ * reusing the buffer allocation (atmi.dict_to_ubf(d, into=proxy)).
+ * Returns -1 with Python exception set on failure.
+ */
+int ubfproxy_refill(PyObject* proxy, PyObject* dict)
+{
+	UbfProxyObject* self = (UbfProxyObject*)proxy;
+
+	if (NULL == ubfproxy_buffer(proxy))
+	{
+		return -1;
+	}
+
+	if (!self->writable)
+	{
+		PyErr_SetString(PyExc_TypeError, "UbfProxy: buffer is read-only (see CONV_INPLACE)");
+		return -1;
+	}
+
+	PyDict_Clear(self->cache);
+	PyDict_Clear(self->snap);
+
+	return dict_refill_ubf(&self->ubf, dict, self->owned);
+}
+
+static Py_ssize_t ubfproxy_length(UbfProxyObject* self)
+{
+	PyObject* keys;
+	Py_ssize_t len;
+
+	if ((keys = ubfproxy_keys(self)) == NULL)
+	{
+		return -1;
+	}
+	len = PyList_GET_SIZE(keys);
+	Py_DECREF(keys);
+
+	return len;
+}
+
+static int ubfproxy_contains(UbfProxyObject* self, PyObject* key)
+{
+	UBFH* ubf;
+	BFLDID id;
+
+	if (PyDict_GetItem(self->cache, key))
+	{
+		return 1;
+	}
+
+	if ((ubf = ubfproxy_buffer((PyObject*)self)) == NULL)
+	{
+		return -1;
+	}
+
+	if ((id = ubf_fldid(key)) == BBADFLDID)
+	{
+		/* not a field name: not in the buffer */
+		PyErr_Clear();
+		return 0;
+	}
+
+	return Bpres(ubf, id, 0) ? 1 : 0;
+}
+
+static PyObject* ubfproxy_has_key(UbfProxyObject* self, PyObject* key)
+{
+	int ret = ubfproxy_contains(self, key);
+
+	if (ret < 0)
+	{
+		return NULL;
+	}
+
+	return PyBool_FromLong(ret);
+}
+
+static PyObject* ubfproxy_get(UbfProxyObject* self, PyObject* args)
+{
+	PyObject* key;
+	PyObject* def = Py_None;
+	PyObject* list;
+
+	if (!PyArg_ParseTuple(args, "O|O", &key, &def))
+	{
+		return NULL;
+	}
+
+	if ((list = ubfproxy_lookup(self, key)) == NULL)
+	{
+		if (PyErr_Occurred())
+		{
+			return NULL;
+		}
+		Py_INCREF(def);
+		list = def;
+	}
+
+	return list;
+}
+
+/*
+ * Convert the whole buffer to dictionary (values already converted
+ * are taken from the cache).
+ */
+static PyObject* ubfproxy_todict(UbfProxyObject* self)
+{
+	PyObject* keys;
+	PyObject* dict;
+	Py_ssize_t i;
+
+	if (NULL == self->ubf)
+	{
+		/* released buffer: what we have is what we got */
+		return PyDict_Copy(self->cache);
+	}
+
+	if ((keys = ubfproxy_keys(self)) == NULL)
+	{
+		return NULL;
+	}
+
+	if ((dict = PyDict_New()) == NULL)
+	{
+		Py_DECREF(keys);
+		return NULL;
+	}
+
+	for (i = 0; i < PyList_GET_SIZE(keys); i++)
+	{
+		PyObject* key = PyList_GET_ITEM(keys, i);
+		PyObject* list;
+
+		if ((list = ubfproxy_lookup(self, key)) == NULL ||
+			PyDict_SetItem(dict, key, list) < 0)
+		{
+			if (!PyErr_Occurred())
+			{
+				PyErr_SetObject(PyExc_KeyError, key);
+			}
+			Py_XDECREF(list);
+			Py_DECREF(dict);
+			Py_DECREF(keys);
+			return NULL;
+		}
+		Py_DECREF(list);
+	}
+
+	Py_DECREF(keys);
+
+	return dict;
+}
+
+/*
+ * Pickle support: the proxy is rebuilt from the binary buffer form by
+ * atmi.ubf_frombytes(data, CONV_PROXY).
+ */
+static PyObject* ubfproxy_reduce(UbfProxyObject* self)
+{
+	PyObject* data;
+	PyObject* ret;
+
+	if (NULL == ubfproxy_unpickler)
+	{
+		PyErr_SetString(PyExc_RuntimeError, "UbfProxy: atmi.ubf_frombytes not available");
+		return NULL;
+	}
+
+	if (ubfproxy_sync((PyObject*)self) < 0 ||
+		ubfproxy_buffer((PyObject*)self) == NULL ||
+		(data = ubf_to_bytes(self->ubf)) == NULL)
+	{
+		return NULL;
+	}
+
+	ret = Py_BuildValue("O(Ol)", ubfproxy_unpickler, data, (long)NDRXPY_CONV_PROXY);
+	Py_DECREF(data);
+
+	return ret;
+}
+
+static PyObject* ubfproxy_values_items(UbfProxyObject* self, int items)
+{
+	PyObject* dict;
+	PyObject* ret;
+
+	if ((dict = ubfproxy_todict(self)) == NULL)
+	{
+		return NULL;
+	}
+	ret = items ? PyDict_Items(dict) : PyDict_Values(dict);
+	Py_DECREF(dict);
+
+	return ret;
+}
+
+static PyObject* ubfproxy_values(UbfProxyObject* self)
+{
+	return ubfproxy_values_items(self, 0);
+}
+
+static PyObject* ubfproxy_items(UbfProxyObject* self)
+{
+	return ubfproxy_values_items(self, 1);
+}
+
+static PyObject* ubfproxy_iter(UbfProxyObject* self)
+{
+	PyObject* keys;
+	PyObject* it;
+
+	if ((keys = ubfproxy_keys(self)) == NULL)
+	{
+		return NULL;
+	}
+	it = PyObject_GetIter(keys);
+	Py_DECREF(keys);
+
+	return it;
+}
+
+static PyObject* ubfproxy_repr(UbfProxyObject* self)
+{
+	PyObject* dict;
+	PyObject* ret;
+
+	if ((dict = ubfproxy_todict(self)) == NULL)
+	{
+		return NULL;
+	}
+	ret = PyObject_Repr(dict);
+	Py_DECREF(dict);
+
+	return ret;
+}
+
+/*
+ * Compare by contents, with other proxies or dictionaries
+ */
+static PyObject* ubfproxy_richcompare(PyObject* a, PyObject* b, int op)
+{
+	PyObject* da = NULL;
+	PyObject* db = NULL;
+	PyObject* ret = NULL;
+
+	if ((op != Py_EQ && op != Py_NE) ||
+		!(UbfProxy_Check(a) || PyDict_Check(a)) ||
+		!(UbfProxy_Check(b) || PyDict_Check(b)))
+	{
+		Py_INCREF(Py_NotImplemented);
+		return Py_NotImplemented;
+	}
+
+	if (UbfProxy_Check(a))
+	{
+		da = ubfproxy_todict((UbfProxyObject*)a);
+	}
+	else
+	{
+		Py_INCREF(a);
+		da = a;
+	}
+
+	if (UbfProxy_Check(b))
+	{
+		db = ubfproxy_todict((UbfProxyObject*)b);
+	}
+	else
+	{
+		Py_INCREF(b);
+		db = b;
+	}
+
+	if (da && db)
+	{
+		ret = PyObject_RichCompare(da, db, op);
+	}
+
+	Py_XDECREF(da);
+	Py_XDECREF(db);
+
+	return ret;
+}
+
+static int ubfproxy_init(UbfProxyObject* self, PyObject* args, PyObject* kwds)
+{
+	PyObject* dict = NULL;
+	UBFH* ubf;
+
+	if (!PyArg_ParseTuple(args, "|O!:UbfProxy", &PyDict_Type, &dict))
+	{
+		return -1;
+	}
+
+	if (dict)
+	{
+		ubf = dict_to_ubf(dict);
+	}
+	else if ((ubf = (UBFH*)tpalloc("UBF", NULL, 1024)) == NULL)
+	{
+		char tmp[200] = "";
+		sprintf(tmp, "tpalloc(): %d - %s", tperrno, tpstrerror(tperrno));
+		PyErr_SetString(PyExc_RuntimeError, tmp);
+	}
+
+	if (NULL == ubf)
+	{
+		return -1;
+	}
+
+	ubfproxy_release((PyObject*)self);
+	PyDict_Clear(self->cache);
+	PyDict_Clear(self->snap);
+	self->ubf = ubf;
+	self->owned = 1;
+	self->writable = 1;
+
+	return 0;
+}
+
+static PyObject* ubfproxy_tpnew(PyTypeObject* type, PyObject* args, PyObject* kwds)
+{
+	UbfProxyObject* self;
+
+	if ((self = (UbfProxyObject*)type->tp_alloc(type, 0)) == NULL)
+	{
+		return NULL;
+	}
+
+	if ((self->cache = PyDict_New()) == NULL ||
+		(self->snap = PyDict_New()) == NULL)
+	{
+		Py_DECREF(self);
+		return NULL;
+	}
+
+	return (PyObject*)self;
+}
+
+static void ubfproxy_dealloc(UbfProxyObject* self)
+{
+	ubfproxy_release((PyObject*)self);
+	Py_XDECREF(self->cache);
+	Py_XDECREF(self->snap);
+	Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyMappingMethods ubfproxy_as_mapping = {
+	(lenfunc)ubfproxy_length,		/* mp_length */
+	(binaryfunc)ubfproxy_subscript,		/* mp_subscript */
+	(objobjargproc)ubfproxy_ass_subscript,	/* mp_ass_subscript */
+};
+
+static PySequenceMethods ubfproxy_as_sequence = {
+	0,					/* sq_length */
+	0,					/* sq_concat */
+	0,					/* sq_repeat */
+	0,					/* sq_item */
+	0,					/* sq_slice */
+	0,					/* sq_ass_item */
+	0,					/* sq_ass_slice */
+	(objobjproc)ubfproxy_contains,		/* sq_contains */
+};
+
+static PyMethodDef ubfproxy_methods[] = {
+	{"keys",	(PyCFunction)ubfproxy_keys,	METH_NOARGS, "-> list of field names"},
+	{"values",	(PyCFunction)ubfproxy_values,	METH_NOARGS, "-> list of occurrence lists"},
+	{"items",	(PyCFunction)ubfproxy_items,	METH_NOARGS, "-> list of (name, occurrences)"},
+	{"has_key",	(PyCFunction)ubfproxy_has_key,	METH_O,	"args: (name)"},
+	{"get",		(PyCFunction)ubfproxy_get,	METH_VARARGS, "args: (name, [default])"},
+	{"todict",	(PyCFunction)ubfproxy_todict,	METH_NOARGS, "-> dictionary like ubf_to_dict()"},
+	{"update",	(PyCFunction)ubfproxy_update,	METH_O,	"args: ({fields}), replaces the given fields"},
+	{"__reduce__",	(PyCFunction)ubfproxy_reduce,	METH_NOARGS, "pickle support, see atmi.ubf_tobytes()"},
+	{NULL,		NULL,				0}
+};
+
+PyTypeObject UbfProxy_Type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"atmi.UbfProxy",			/* tp_name */
+	sizeof(UbfProxyObject),			/* tp_basicsize */
+	0,					/* tp_itemsize */
+	(destructor)ubfproxy_dealloc,		/* tp_dealloc */
+	0,					/* tp_print */
+	0,					/* tp_getattr */
+	0,					/* tp_setattr */
+	0,					/* tp_compare */
+	(reprfunc)ubfproxy_repr,		/* tp_repr */
+	0,					/* tp_as_number */
+	&ubfproxy_as_sequence,			/* tp_as_sequence */
+	&ubfproxy_as_mapping,			/* tp_as_mapping */
+	0,					/* tp_hash */
+	0,					/* tp_call */
+	0,					/* tp_str */
+	0,					/* tp_getattro */
+	0,					/* tp_setattro */
+	0,					/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT,			/* tp_flags */
+	"Mapping view on a UBF buffer, fields are converted on access",	/* tp_doc */
+	0,					/* tp_traverse */
+	0,					/* tp_clear */
+	ubfproxy_richcompare,			/* tp_richcompare */
+	0,					/* tp_weaklistoffset */
+	(getiterfunc)ubfproxy_iter,		/* tp_iter */
+	0,					/* tp_iternext */
+	ubfproxy_methods,			/* tp_methods */
+	0,					/* tp_members */
+	0,					/* tp_getset */
+	0,					/* tp_base */
+	0,					/* tp_dict */
+	0,					/* tp_descr_get */
+	0,					/* tp_descr_set */
+	0,					/* tp_dictoffset */
+	(initproc)ubfproxy_init,		/* tp_init */
+	0,					/* tp_alloc */
+	ubfproxy_tpnew,				/* tp_new */
+};
+
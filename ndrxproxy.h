@@ -0,0 +1,46 @@
+/*
+   This file declares the atmi.UbfProxy type: a mapping view on a live
+   ENDUROX UBF buffer, converting fields to Python on demand.
+
+   (c) 2017 Mavimax, SIA
+
+
+*/
+
+
+#ifndef NDRXPROXY_H
+#define NDRXPROXY_H
+
+
+
+#include <ubf.h>     /* ENDUROX Header File */
+
+
+typedef struct {
+    PyObject_HEAD
+    UBFH* ubf;          /* UBF buffer, NULL when released */
+    int owned;          /* buffer is tpfree'd together with the proxy */
+    int writable;       /* changes go to the buffer (else read-only) */
+    PyObject* cache;    /* field name -> list of already converted occurrences */
+    PyObject* snap;     /* field name -> occurrences as converted (tuple), to
+                           find lists changed in place */
+} UbfProxyObject;
+
+extern PyTypeObject UbfProxy_Type;
+
+#define UbfProxy_Check(op) PyObject_TypeCheck(op, &UbfProxy_Type)
+
+extern PyObject* ubfproxy_new(UBFH* ubf, int owned, int writable);
+extern UBFH* ubfproxy_buffer(PyObject* proxy);
+extern UBFH* ubfproxy_copy(PyObject* proxy);
+extern int ubfproxy_sync(PyObject* proxy);
+extern void ubfproxy_release(PyObject* proxy);
+extern int ubfproxy_refill(PyObject* proxy, PyObject* dict);
+
+/* atmi.ubf_frombytes, set at module init (pickle support) */
+extern PyObject* ubfproxy_unpickler;
+
+
+
+#endif /* NDRXPROXY_H */
+
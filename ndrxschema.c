@@ -0,0 +1,688 @@
+/*
+   This file implements the atmi.Schema and atmi.Record types. A schema
+   lists the fields a service works with; field ids and types are
+   resolved when the schema is made, so decoding and encoding a record
+   walks the plan without any name lookups. Each field is either scalar
+   (first occurrence or None) or repeated (list of all occurrences).
+
+   Records keep the values in fixed slots and are accessed by attribute
+   (rec.T_NAME_FLD) or by key (rec['T_NAME_FLD']).
+
+   (c) 2017 Mavimax, SIA
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atmi.h>     /* ENDUROX Header File */
+#include <ubf.h>    /* ENDUROX Header File */
+
+#include <ndebug.h>
+#include <Python.h>
+#include <structmember.h>
+
+#include "ndrxconvert.h"
+#include "ndrxproxy.h"
+#include "ndrxschema.h"
+
+/*
+ * Make empty record of the schema: scalars None, repeated fields [].
+ */
+static RecordObject* record_new(SchemaObject* schema)
+{
+	RecordObject* self;
+	Py_ssize_t i;
+	int failed = 0;
+
+	if ((self = PyObject_NewVar(RecordObject, &Record_Type, schema->n)) == NULL)
+	{
+		return NULL;
+	}
+
+	Py_INCREF(schema);
+	self->schema = schema;
+
+	for (i = 0; i < schema->n; i++)
+	{
+		if (schema->repeated[i] && !failed &&
+			(self->slots[i] = PyList_New(0)) != NULL)
+		{
+			continue;
+		}
+		failed |= schema->repeated[i];
+		Py_INCREF(Py_None);
+		self->slots[i] = Py_None;
+	}
+
+	if (failed)
+	{
+		Py_DECREF(self);
+		return NULL;
+	}
+
+	return self;
+}
+
+/*
+ * Slot index of the field name, -1 with KeyError/AttributeError (given
+ * as `exc') set if the schema has no such field.
+ */
+static Py_ssize_t record_slot(RecordObject* self, PyObject* name, PyObject* exc)
+{
+	PyObject* idx;
+
+	if ((idx = PyDict_GetItem(self->schema->index, name)) == NULL)
+	{
+		if (exc)
+		{
+			PyErr_SetObject(exc, name);
+		}
+		return -1;
+	}
+
+	return PyInt_AS_LONG(idx);
+}
+
+/*
+ * Decode UBF buffer by the schema into new record.
+ * Returns NULL with Python exception set on failure.
+ */
+PyObject* ubf_to_record(PyObject* schema, UBFH* ubf)
+{
+	SchemaObject* sch = (SchemaObject*)schema;
+	RecordObject* rec;
+	Py_ssize_t i;
+
+	if ((rec = record_new(sch)) == NULL)
+	{
+		return NULL;
+	}
+
+	for (i = 0; i < sch->n; i++)
+	{
+		PyObject* pyval;
+
+		if (sch->repeated[i])
+		{
+			pyval = ubf_field_to_list(ubf, sch->ids[i], 0);
+		}
+		else if (Bpres(ubf, sch->ids[i], 0))
+		{
+			pyval = ubf_field_to_py(ubf, sch->ids[i], 0, 0);
+		}
+		else
+		{
+			continue;
+		}
+
+		if (NULL == pyval)
+		{
+			Py_DECREF(rec);
+			return NULL;
+		}
+		Py_DECREF(rec->slots[i]);
+		rec->slots[i] = pyval;
+	}
+
+	return (PyObject*)rec;
+}
+
+/*
+ * Encode the record to new UBF buffer.
+ * Returns NULL with Python exception set on failure.
+ */
+UBFH* record_to_ubf(PyObject* record)
+{
+	RecordObject* rec = (RecordObject*)record;
+	SchemaObject* sch = rec->schema;
+	UBFH* ubf;
+	BFLDOCC nocc = 0;
+	long datalen = 0;
+	Py_ssize_t i;
+
+	for (i = 0; i < sch->n; i++)
+	{
+		if (Py_None != rec->slots[i])
+		{
+			ubf_size_add(rec->slots[i], &nocc, &datalen);
+		}
+	}
+
+	if ((ubf = ubf_alloc(nocc, datalen)) == NULL)
+	{
+		return NULL;
+	}
+
+	for (i = 0; i < sch->n; i++)
+	{
+		if (Py_None != rec->slots[i] &&
+			ubf_add_field(&ubf, sch->ids[i], rec->slots[i]) < 0)
+		{
+			ubf_tpfree((char*)ubf);
+			return NULL;
+		}
+	}
+
+	NDRXPY_DUMP_UBF("Record buffer", ubf);
+
+	return ubf;
+}
+
+/*
+ * Store the record fields to the buffer it was decoded from; None fields
+ * are deleted, fields not in the schema stay untouched. *pp_ub may be
+ * reallocated.
+ * Returns -1 with Python exception set on failure.
+ */
+int record_merge_ubf(UBFH** pp_ub, PyObject* record)
+{
+	RecordObject* rec = (RecordObject*)record;
+	SchemaObject* sch = rec->schema;
+	Py_ssize_t i;
+
+	for (i = 0; i < sch->n; i++)
+	{
+		if (Py_None != rec->slots[i])
+		{
+			if (ubf_set_field(pp_ub, sch->ids[i], rec->slots[i]) < 0)
+			{
+				return -1;
+			}
+		}
+		else if (Bdelall(*pp_ub, sch->ids[i]) < 0 && BNOTPRES != Berror)
+		{
+			char tmp[200] = "";
+			sprintf(tmp, "Bdelall(%.64s): %d - %s", Bfname(sch->ids[i]),
+				Berror, Bstrerror(Berror));
+			PyErr_SetString(PyExc_RuntimeError, tmp);
+			return -1;
+		}
+	}
+
+	NDRXPY_DUMP_UBF("Merged buffer", *pp_ub);
+
+	return 0;
+}
+
+/* {{{ atmi.Record */
+
+static PyObject* record_getattro(RecordObject* self, PyObject* name)
+{
+	Py_ssize_t i;
+
+	if ((i = record_slot(self, name, NULL)) >= 0)
+	{
+		Py_INCREF(self->slots[i]);
+		return self->slots[i];
+	}
+
+	return PyObject_GenericGetAttr((PyObject*)self, name);
+}
+
+static int record_setattro(RecordObject* self, PyObject* name, PyObject* value)
+{
+	Py_ssize_t i;
+
+	if ((i = record_slot(self, name, PyExc_AttributeError)) < 0)
+	{
+		return -1;
+	}
+
+	if (NULL == value)
+	{
+		value = Py_None;
+	}
+	Py_INCREF(value);
+	Py_DECREF(self->slots[i]);
+	self->slots[i] = value;
+
+	return 0;
+}
+
+static Py_ssize_t record_length(RecordObject* self)
+{
+	return Py_SIZE(self);
+}
+
+static PyObject* record_subscript(RecordObject* self, PyObject* key)
+{
+	Py_ssize_t i;
+
+	if ((i = record_slot(self, key, PyExc_KeyError)) < 0)
+	{
+		return NULL;
+	}
+
+	Py_INCREF(self->slots[i]);
+	return self->slots[i];
+}
+
+static int record_ass_subscript(RecordObject* self, PyObject* key, PyObject* value)
+{
+	Py_ssize_t i;
+
+	if ((i = record_slot(self, key, PyExc_KeyError)) < 0)
+	{
+		return -1;
+	}
+
+	if (NULL == value)
+	{
+		value = Py_None;
+	}
+	Py_INCREF(value);
+	Py_DECREF(self->slots[i]);
+	self->slots[i] = value;
+
+	return 0;
+}
+
+static PyObject* record_keys(RecordObject* self)
+{
+	return PySequence_List(self->schema->names);
+}
+
+static PyObject* record_todict(RecordObject* self)
+{
+	PyObject* dict;
+	Py_ssize_t i;
+
+	if ((dict = PyDict_New()) == NULL)
+	{
+		return NULL;
+	}
+
+	for (i = 0; i < Py_SIZE(self); i++)
+	{
+		if (Py_None != self->slots[i] &&
+			PyDict_SetItem(dict, PyTuple_GET_ITEM(self->schema->names, i),
+				self->slots[i]) < 0)
+		{
+			Py_DECREF(dict);
+			return NULL;
+		}
+	}
+
+	return dict;
+}
+
+static PyObject* record_repr(RecordObject* self)
+{
+	PyObject* dict;
+	PyObject* ret;
+
+	if ((dict = record_todict(self)) == NULL)
+	{
+		return NULL;
+	}
+
+	ret = PyObject_Repr(dict);
+	Py_DECREF(dict);
+
+	if (ret)
+	{
+		PyObject* tmp = PyString_FromFormat("Record(%s)", PyString_AS_STRING(ret));
+		Py_DECREF(ret);
+		ret = tmp;
+	}
+
+	return ret;
+}
+
+static PyObject* record_richcompare(PyObject* a, PyObject* b, int op)
+{
+	PyObject* da = NULL;
+	PyObject* db = NULL;
+	PyObject* ret = NULL;
+
+	if ((op != Py_EQ && op != Py_NE) ||
+		!(PyDict_Check(b) || Record_Check(b)) ||
+		!(PyDict_Check(a) || Record_Check(a)))
+	{
+		Py_INCREF(Py_NotImplemented);
+		return Py_NotImplemented;
+	}
+
+	da = Record_Check(a) ? record_todict((RecordObject*)a) : (Py_INCREF(a), a);
+	db = Record_Check(b) ? record_todict((RecordObject*)b) : (Py_INCREF(b), b);
+
+	if (da && db)
+	{
+		ret = PyObject_RichCompare(da, db, op);
+	}
+
+	Py_XDECREF(da);
+	Py_XDECREF(db);
+
+	return ret;
+}
+
+static void record_dealloc(RecordObject* self)
+{
+	Py_ssize_t i;
+
+	for (i = 0; i < Py_SIZE(self); i++)
+	{
+		Py_XDECREF(self->slots[i]);
+	}
+	Py_XDECREF(self->schema);
+	PyObject_Del(self);
+}
+
+static PyMappingMethods record_as_mapping = {
+	(lenfunc)record_length,			/* mp_length */
+	(binaryfunc)record_subscript,		/* mp_subscript */
+	(objobjargproc)record_ass_subscript,	/* mp_ass_subscript */
+};
+
+static PyMethodDef record_methods[] = {
+	{"keys",	(PyCFunction)record_keys,	METH_NOARGS, "-> list of schema field names"},
+	{"todict",	(PyCFunction)record_todict,	METH_NOARGS, "-> dictionary of the fields set"},
+	{NULL,		NULL,				0}
+};
+
+static PyMemberDef record_members[] = {
+	{"schema",	T_OBJECT, offsetof(RecordObject, schema), READONLY, "atmi.Schema of the record"},
+	{NULL}
+};
+
+PyTypeObject Record_Type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"atmi.Record",				/* tp_name */
+	offsetof(RecordObject, slots),		/* tp_basicsize */
+	sizeof(PyObject*),			/* tp_itemsize */
+	(destructor)record_dealloc,		/* tp_dealloc */
+	0,					/* tp_print */
+	0,					/* tp_getattr */
+	0,					/* tp_setattr */
+	0,					/* tp_compare */
+	(reprfunc)record_repr,			/* tp_repr */
+	0,					/* tp_as_number */
+	0,					/* tp_as_sequence */
+	&record_as_mapping,			/* tp_as_mapping */
+	0,					/* tp_hash */
+	0,					/* tp_call */
+	0,					/* tp_str */
+	(getattrofunc)record_getattro,		/* tp_getattro */
+	(setattrofunc)record_setattro,		/* tp_setattro */
+	0,					/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT,			/* tp_flags */
+	"UBF record with one slot per atmi.Schema field",	/* tp_doc */
+	0,					/* tp_traverse */
+	0,					/* tp_clear */
+	record_richcompare,			/* tp_richcompare */
+	0,					/* tp_weaklistoffset */
+	0,					/* tp_iter */
+	0,					/* tp_iternext */
+	record_methods,				/* tp_methods */
+	record_members,				/* tp_members */
+};
+
+/* }}} */
+/* {{{ atmi.Schema */
+
+/*
+ * Schema(fields): each item is field name / id (scalar field) or tuple
+ * (name or id, repeated).
+ */
+static PyObject* schema_tpnew(PyTypeObject* type, PyObject* args, PyObject* kwds)
+{
+	SchemaObject* self = NULL;
+	PyObject* fields;
+	PyObject* seq = NULL;
+	Py_ssize_t i, n;
+
+	if (!PyArg_ParseTuple(args, "O:Schema", &fields) ||
+		(seq = PySequence_Fast(fields, "Schema: sequence of fields expected")) == NULL)
+	{
+		goto err;
+	}
+	n = PySequence_Fast_GET_SIZE(seq);
+
+	if ((self = (SchemaObject*)type->tp_alloc(type, 0)) == NULL)
+	{
+		goto err;
+	}
+	self->n = n;
+
+	if ((self->ids = (BFLDID*)malloc(sizeof(BFLDID) * (n + 1))) == NULL ||
+		(self->repeated = (char*)malloc(n + 1)) == NULL)
+	{
+		PyErr_NoMemory();
+		goto err;
+	}
+
+	if ((self->names = PyTuple_New(n)) == NULL ||
+		(self->index = PyDict_New()) == NULL)
+	{
+		goto err;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		PyObject* item = PySequence_Fast_GET_ITEM(seq, i);
+		PyObject* key = item;
+		PyObject* name;
+		PyObject* idx;
+		int repeated = 0;
+
+		if (PyTuple_Check(item))
+		{
+			PyObject* rep = Py_False;
+
+			if (!PyArg_ParseTuple(item, "O|O:Schema field", &key, &rep) ||
+				(repeated = PyObject_IsTrue(rep)) < 0)
+			{
+				goto err;
+			}
+		}
+
+		if (PyInt_Check(key) || PyLong_Check(key))
+		{
+			self->ids[i] = (BFLDID)PyInt_AsLong(key);
+			name = ubf_fldname(self->ids[i]);
+		}
+		else if ((self->ids[i] = ubf_fldid(key)) != BBADFLDID)
+		{
+			name = ubf_fldname(self->ids[i]);
+		}
+		else
+		{
+			goto err;
+		}
+
+		if (NULL == name)
+		{
+			goto err;
+		}
+
+		if (PyDict_GetItem(self->index, name))
+		{
+			PyErr_Format(PyExc_ValueError, "Schema: field %s given twice",
+				PyString_AS_STRING(name));
+			goto err;
+		}
+
+		/* types the record codec converts (see ubf_field_to_py()) */
+		if (BFLD_INT == Bfldtype(self->ids[i]) || Bfldtype(self->ids[i]) > BFLD_VIEW)
+		{
+			PyErr_Format(PyExc_TypeError, "Schema: field %s: unsupported UBF type <%d>",
+				PyString_AS_STRING(name), Bfldtype(self->ids[i]));
+			goto err;
+		}
+
+		self->repeated[i] = (char)repeated;
+		Py_INCREF(name);
+		PyTuple_SET_ITEM(self->names, i, name);
+
+		if ((idx = PyInt_FromSsize_t(i)) == NULL ||
+			PyDict_SetItem(self->index, name, idx) < 0)
+		{
+			Py_XDECREF(idx);
+			goto err;
+		}
+		Py_DECREF(idx);
+	}
+	self->ids[n] = BBADFLDID;
+
+	Py_DECREF(seq);
+	return (PyObject*)self;
+
+err:
+	Py_XDECREF(seq);
+	Py_XDECREF(self);
+	return NULL;
+}
+
+/*
+ * schema(**fields) or schema({fields}): new record.
+ */
+static PyObject* schema_call(SchemaObject* self, PyObject* args, PyObject* kwds)
+{
+	RecordObject* rec;
+	PyObject* init = NULL;
+	PyObject* key;
+	PyObject* value;
+	Py_ssize_t pos;
+	int pass;
+
+	if (!PyArg_ParseTuple(args, "|O!:Schema", &PyDict_Type, &init) ||
+		(rec = record_new(self)) == NULL)
+	{
+		return NULL;
+	}
+
+	for (pass = 0; pass < 2; pass++)
+	{
+		PyObject* src = pass ? kwds : init;
+
+		if (NULL == src)
+		{
+			continue;
+		}
+
+		pos = 0;
+		while (PyDict_Next(src, &pos, &key, &value))
+		{
+			if (record_ass_subscript(rec, key, value) < 0)
+			{
+				Py_DECREF(rec);
+				return NULL;
+			}
+		}
+	}
+
+	return (PyObject*)rec;
+}
+
+/*
+ * schema.decode(UbfProxy or dict): record from the buffer.
+ */
+static PyObject* schema_decode(SchemaObject* self, PyObject* buf)
+{
+	PyObject* ret = NULL;
+	UBFH* ubf;
+
+	if (UbfProxy_Check(buf))
+	{
+		if (ubfproxy_sync(buf) == 0 && (ubf = ubfproxy_buffer(buf)) != NULL)
+		{
+			ret = ubf_to_record((PyObject*)self, ubf);
+		}
+	}
+	else if (PyDict_Check(buf))
+	{
+		if ((ubf = dict_to_ubf(buf)) != NULL)
+		{
+			ret = ubf_to_record((PyObject*)self, ubf);
+			ubf_tpfree((char*)ubf);
+		}
+	}
+	else
+	{
+		PyErr_SetString(PyExc_TypeError, "Schema.decode(): UbfProxy or dictionary expected");
+	}
+
+	return ret;
+}
+
+static PyObject* schema_repr(SchemaObject* self)
+{
+	PyObject* names;
+	PyObject* ret;
+
+	if ((names = PyObject_Repr(self->names)) == NULL)
+	{
+		return NULL;
+	}
+
+	ret = PyString_FromFormat("Schema(%s)", PyString_AS_STRING(names));
+	Py_DECREF(names);
+
+	return ret;
+}
+
+static void schema_dealloc(SchemaObject* self)
+{
+	free(self->ids);
+	free(self->repeated);
+	Py_XDECREF(self->names);
+	Py_XDECREF(self->index);
+	Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyMethodDef schema_methods[] = {
+	{"decode",	(PyCFunction)schema_decode,	METH_O,	"args: (UbfProxy or dict) -> Record"},
+	{NULL,		NULL,				0}
+};
+
+static PyMemberDef schema_members[] = {
+	{"fields",	T_OBJECT, offsetof(SchemaObject, names), READONLY, "tuple of field names"},
+	{NULL}
+};
+
+PyTypeObject Schema_Type = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"atmi.Schema",				/* tp_name */
+	sizeof(SchemaObject),			/* tp_basicsize */
+	0,					/* tp_itemsize */
+	(destructor)schema_dealloc,		/* tp_dealloc */
+	0,					/* tp_print */
+	0,					/* tp_getattr */
+	0,					/* tp_setattr */
+	0,					/* tp_compare */
+	(reprfunc)schema_repr,			/* tp_repr */
+	0,					/* tp_as_number */
+	0,					/* tp_as_sequence */
+	0,					/* tp_as_mapping */
+	0,					/* tp_hash */
+	(ternaryfunc)schema_call,		/* tp_call */
+	0,					/* tp_str */
+	0,					/* tp_getattro */
+	0,					/* tp_setattro */
+	0,					/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT,			/* tp_flags */
+	"UBF field plan: Schema([name, (name, repeated), ...])",	/* tp_doc */
+	0,					/* tp_traverse */
+	0,					/* tp_clear */
+	0,					/* tp_richcompare */
+	0,					/* tp_weaklistoffset */
+	0,					/* tp_iter */
+	0,					/* tp_iternext */
+	schema_methods,				/* tp_methods */
+	schema_members,				/* tp_members */
+	0,					/* tp_getset */
+	0,					/* tp_base */
+	0,					/* tp_dict */
+	0,					/* tp_descr_get */
+	0,					/* tp_descr_set */
+	0,					/* tp_dictoffset */
+	0,					/* tp_init */
+	0,					/* tp_alloc */
+	schema_tpnew,				/* tp_new */
+};
+
+/* }}} */
+
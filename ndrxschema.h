@@ -0,0 +1,48 @@
+/*
+   This file declares the atmi.Schema and atmi.Record types: a field plan
+   resolved once (ids, types, scalar or repeated) and records with one
+   fixed slot per schema field.
+
+   (c) 2017 Mavimax, SIA
+
+
+*/
+
+
+#ifndef NDRXSCHEMA_H
+#define NDRXSCHEMA_H
+
+
+
+#include <ubf.h>     /* ENDUROX Header File */
+
+
+typedef struct {
+    PyObject_HEAD
+    Py_ssize_t n;       /* number of fields */
+    BFLDID* ids;        /* field ids */
+    char* repeated;     /* field holds list of occurrences (else scalar) */
+    PyObject* names;    /* tuple of field names */
+    PyObject* index;    /* field name -> slot index */
+} SchemaObject;
+
+typedef struct {
+    PyObject_VAR_HEAD
+    SchemaObject* schema;
+    PyObject* slots[1]; /* ob_size values, None / [] if not present */
+} RecordObject;
+
+extern PyTypeObject Schema_Type;
+extern PyTypeObject Record_Type;
+
+#define Schema_Check(op) PyObject_TypeCheck(op, &Schema_Type)
+#define Record_Check(op) PyObject_TypeCheck(op, &Record_Type)
+
+extern PyObject* ubf_to_record(PyObject* schema, UBFH* ubf);
+extern UBFH* record_to_ubf(PyObject* rec);
+extern int record_merge_ubf(UBFH** pp_ub, PyObject* rec);
+
+
+
+#endif /* NDRXSCHEMA_H */
+
@@ -54,12 +54,15 @@ elif os.name == 'posix':
 #extra_compile_args.append("-DDEBUG")
 #extra_compile_args.append("-g")
 
+# Compile out the logging on the buffer conversion / dispatch paths
+#extra_compile_args.append("-DNDRXPY_NO_HOTLOG")
+
 
 # build the atmi and atmi/WS modules
 endurox_ext = Extension(name = 'endurox.atmi',
 		     define_macros = [("NDRXVERSION", ndrxversion)], 
 		     undef_macros = ["NDRXWS"], 
-                     sources = ['ndrxconvert.c', 'ndrxmodule.c', 'ndrxloop.c' ],
+                     sources = ['ndrxconvert.c', 'ndrxproxy.c', 'ndrxexpr.c', 'ndrxschema.c', 'ndrxjson.c', 'ndrxaggr.c', 'ndrxcall.c', 'ndrxpool.c', 'ndrxmodule.c', 'ndrxloop.c' ],
                      include_dirs = include_dirs,
                      library_dirs = library_dirs,
                      libraries = libraries,
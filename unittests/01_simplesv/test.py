@@ -20,9 +20,8 @@ class server:
                 arg['T_STRING_4_FLD'].append("HELLO from Mars")
                 arg['T_STRING_4_FLD'].append("HELLO from Venus")
 
-                # Curently will not work as types does not match string
-                # so basically this is Bchg, not CB...
-                #arg['T_STRING_5_FLD']=1
+                # Numbers are converted to the field type (here string)
+                arg['T_STRING_5_FLD']=1
                 tplog(log_error, str(arg))
                 return arg
         except Exception as e:
@@ -0,0 +1,27 @@
+#!/usr/bin/python
+#
+# Client of the 02_fldcache server (test.py), exits with error on failure
+#
+import sys
+
+from endurox.atmi import *
+
+# all fields of the tables resolved up front
+assert fldcache_preload() > 0
+
+for i in range(1000):
+    res = tpcall("ECHO", {"T_STRING_FLD": "val %d" % i, "T_LONG_FLD": i})
+    assert res["T_STRING_FLD"] == ["val %d" % i], res
+    assert res["T_STRING_2_FLD"] == ["val %d" % i], res
+    assert res["T_LONG_FLD"] == [i], res
+
+# names not in the field tables are still reported
+try:
+    tpcall("ECHO", {"NO_SUCH_FLD": "x"})
+except Exception as e:
+    pass
+else:
+    raise AssertionError("unknown field accepted")
+
+tpterm()
+print "02_fldcache: OK"
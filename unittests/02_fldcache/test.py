@@ -0,0 +1,26 @@
+#!/usr/bin/python
+import sys
+
+from endurox.atmi import *
+
+class server:
+    def ECHO(self, arg):
+        # same field names over and over: resolved from the field cache
+        arg["T_STRING_2_FLD"] = arg["T_STRING_FLD"]
+        return arg
+
+    def init(self, arguments):
+        try:
+                tpadvertise("ECHO", "ECHO")
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 02_fldcache called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
@@ -0,0 +1,40 @@
+#!/usr/bin/python
+#
+# Client of the 03_typedenc server (test.py), exits with error on failure
+#
+import sys
+
+from endurox.atmi import *
+
+res = tpcall("TYPES", {"T_SHORT_FLD": 12, "T_LONG_FLD": 100000,
+                       "T_CHAR_FLD": "A", "T_FLOAT_FLD": 1.5,
+                       "T_DOUBLE_FLD": 2.25, "T_STRING_FLD": u"uni"})
+assert res["T_SHORT_FLD"] == [13], res
+assert res["T_LONG_FLD"] == [100001], res
+assert res["T_CHAR_FLD"] == [ord("B")], res
+assert res["T_FLOAT_FLD"] == [3.0], res
+assert res["T_DOUBLE_FLD"] == [4.5], res
+assert res["T_STRING_FLD"] == ["uni!"], res
+
+# text is parsed by libubf for the numeric fields, numbers go to strings
+res = tpcall("TYPES", {"T_SHORT_FLD": "7", "T_LONG_FLD": u"41",
+                       "T_CHAR_FLD": 65, "T_FLOAT_FLD": "0.25",
+                       "T_DOUBLE_FLD": 1, "T_STRING_FLD": 5})
+assert res["T_SHORT_FLD"] == [8], res
+assert res["T_LONG_FLD"] == [42], res
+assert res["T_CHAR_FLD"] == [ord("B")], res
+assert res["T_FLOAT_FLD"] == [0.5], res
+assert res["T_DOUBLE_FLD"] == [2.0], res
+assert res["T_STRING_FLD"] == ["5!"], res
+
+# values the field can not hold are refused, not truncated
+for fld, val in (("T_SHORT_FLD", 70000), ("T_CHAR_FLD", 300)):
+    try:
+        tpcall("TYPES", {fld: val})
+    except OverflowError:
+        pass
+    else:
+        raise AssertionError("%s = %d accepted" % (fld, val))
+
+tpterm()
+print "03_typedenc: OK"
@@ -0,0 +1,30 @@
+#!/usr/bin/python
+import sys
+
+from endurox.atmi import *
+
+class server:
+    def TYPES(self, arg):
+        # values are encoded straight to the field type
+        return {"T_SHORT_FLD": arg["T_SHORT_FLD"][0] + 1,
+                "T_LONG_FLD": arg["T_LONG_FLD"][0] + 1,
+                "T_CHAR_FLD": arg["T_CHAR_FLD"][0] + 1,
+                "T_FLOAT_FLD": arg["T_FLOAT_FLD"][0] * 2,
+                "T_DOUBLE_FLD": arg["T_DOUBLE_FLD"][0] * 2,
+                "T_STRING_FLD": arg["T_STRING_FLD"][0] + "!"}
+
+    def init(self, arguments):
+        try:
+                tpadvertise("TYPES", "TYPES")
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 03_typedenc called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
@@ -0,0 +1,18 @@
+#!/usr/bin/python
+#
+# Client of the 04_growbuf server (test.py), exits with error on failure
+#
+import sys
+
+from endurox.atmi import *
+
+# small, then larger than the default buffer size (reply is twice that)
+for count in (1, 10, 150):
+    strs = ["%05d" % i + "x" * 95 for i in range(count)]
+    res = tpcall("GROW", {"T_STRING_FLD": strs, "T_LONG_FLD": range(count)})
+    assert res["T_STRING_FLD"] == strs, count
+    assert res["T_STRING_2_FLD"] == [s.upper() for s in strs], count
+    assert res["T_LONG_FLD"] == range(count), count
+
+tpterm()
+print "04_growbuf: OK"
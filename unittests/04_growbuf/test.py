@@ -0,0 +1,26 @@
+#!/usr/bin/python
+import sys
+
+from endurox.atmi import *
+
+class server:
+    def GROW(self, arg):
+        # reply bigger than the request: the buffer has to grow
+        arg["T_STRING_2_FLD"] = [s.upper() for s in arg["T_STRING_FLD"]]
+        return arg
+
+    def init(self, arguments):
+        try:
+                tpadvertise("GROW", "GROW")
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 04_growbuf called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
@@ -0,0 +1,33 @@
+#!/usr/bin/python
+#
+# Client of the 05_proxy server (test.py), exits with error on failure
+#
+import sys
+
+from endurox.atmi import *
+
+res = tpcall("LAZY", {"T_STRING_FLD": "abc", "T_LONG_FLD": [1, 2]})
+assert res == {"T_STRING_2_FLD": ["ABC"], "T_LONG_FLD": [2], "T_SHORT_FLD": [0]}, res
+
+# replies as proxies
+old = set_convflags(CONV_PROXY)
+res = tpcall("ECHO", {"T_STRING_FLD": "abc", "T_LONG_FLD": [1, 2]})
+set_convflags(old)
+assert isinstance(res, UbfProxy), type(res)
+assert sorted(res.keys()) == ["T_LONG_FLD", "T_STRING_FLD"], res.keys()
+assert res["T_LONG_FLD"] == [1, 2]
+assert res.get("T_DOUBLE_FLD") is None
+assert res.todict() == {"T_STRING_FLD": ["abc"], "T_LONG_FLD": [1, 2]}
+
+# owned proxies are writable; lists changed in place are written back,
+# the fields only read are not touched
+p = UbfProxy({"T_STRING_FLD": "abc", "T_LONG_FLD": [1]})
+assert p["T_STRING_FLD"] == ["abc"]
+p["T_LONG_FLD"].append(2)
+p["T_DOUBLE_FLD"] = [1.5]
+del p["T_STRING_FLD"]
+res = tpcall("ECHO", p)
+assert res == {"T_LONG_FLD": [1, 2], "T_DOUBLE_FLD": [1.5]}, res
+
+tpterm()
+print "05_proxy: OK"
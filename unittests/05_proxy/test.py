@@ -0,0 +1,41 @@
+#!/usr/bin/python
+import sys
+
+from endurox.atmi import *
+
+class server:
+    def LAZY(self, arg):
+        # only the fields looked at are converted
+        if not isinstance(arg, UbfProxy):
+                tplog(log_error, "LAZY: not a proxy: %s" % type(arg))
+                return TPFAIL
+        try:
+                arg["T_STRING_FLD"] = "x"
+        except TypeError:
+                pass
+        else:
+                tplog(log_error, "LAZY: borrowed request is writable")
+                return TPFAIL
+        return {"T_STRING_2_FLD": arg["T_STRING_FLD"][0].upper(),
+                "T_LONG_FLD": len(arg),
+                "T_SHORT_FLD": int("T_DOUBLE_FLD" in arg)}
+
+    def ECHO(self, arg):
+        return arg
+
+    def init(self, arguments):
+        try:
+                tpadvertise("LAZY", "LAZY", CONV_PROXY)
+                tpadvertise("ECHO", "ECHO")
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 05_proxy called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
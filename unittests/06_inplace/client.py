@@ -0,0 +1,20 @@
+#!/usr/bin/python
+#
+# Client of the 06_inplace server (test.py), exits with error on failure
+#
+import sys
+
+from endurox.atmi import *
+
+req = {"T_STRING_FLD": "keep", "T_LONG_FLD": [1, 2, 3], "T_SHORT_FLD": 5,
+       "T_DOUBLE_FLD": [0.5, 1.5]}
+for i in range(100):
+    res = tpcall("UPD", req)
+    assert res == {"T_STRING_FLD": ["keep"], "T_LONG_FLD": [1, 2, 3, 4],
+                   "T_DOUBLE_FLD": [0.5, 1.5], "T_STRING_2_FLD": ["done"]}, res
+
+res = tpcall("NEW", {"T_STRING_FLD": "abc", "T_LONG_FLD": 1})
+assert res == {"T_STRING_FLD": ["cba"]}, res
+
+tpterm()
+print "06_inplace: OK"
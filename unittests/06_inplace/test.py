@@ -0,0 +1,33 @@
+#!/usr/bin/python
+import sys
+
+from endurox.atmi import *
+
+class server:
+    def UPD(self, arg):
+        # request buffer changed in place and returned as is
+        arg["T_STRING_2_FLD"] = "done"
+        arg["T_LONG_FLD"].append(len(arg["T_LONG_FLD"]) + 1)
+        del arg["T_SHORT_FLD"]
+        return arg
+
+    def NEW(self, arg):
+        # a new reply is still fine for an in-place service
+        return {"T_STRING_FLD": arg["T_STRING_FLD"][0][::-1]}
+
+    def init(self, arguments):
+        try:
+                tpadvertise("UPD", "UPD", CONV_INPLACE)
+                tpadvertise("NEW", "NEW", CONV_INPLACE)
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 06_inplace called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
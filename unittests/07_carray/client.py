@@ -0,0 +1,26 @@
+#!/usr/bin/python
+#
+# Client of the 07_carray server (test.py), exits with error on failure
+#
+import sys
+
+from endurox.atmi import *
+
+data = "\x00\x01abc\xff\x00"
+
+# CARRAY buffers, binary zeros included
+for req in (bytearray(data), buffer(data), memoryview(data)):
+    res = tpcall("CAREV", req)
+    assert isinstance(res, bytearray), type(res)
+    assert str(res) == data[::-1], repr(res)
+
+res = tpcall("CAREV", bytearray(30000))
+assert res == bytearray(30000)
+
+# CARRAY fields
+res = tpcall("CAFLD", {"T_CARRAY_FLD": bytearray(data)})
+assert res["T_CARRAY_FLD"] == [data, data[1:], data], res
+assert res["T_LONG_FLD"] == [len(data)], res
+
+tpterm()
+print "07_carray: OK"
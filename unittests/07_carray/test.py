@@ -0,0 +1,36 @@
+#!/usr/bin/python
+import sys
+
+from endurox.atmi import *
+
+class server:
+    def CAREV(self, arg):
+        # CARRAY buffer comes as bytearray
+        if not isinstance(arg, bytearray):
+                tplog(log_error, "CAREV: not a bytearray: %s" % type(arg))
+                return TPFAIL
+        arg.reverse()
+        return arg
+
+    def CAFLD(self, arg):
+        # CARRAY fields: str in, any buffer protocol object out
+        data = arg["T_CARRAY_FLD"][0]
+        return {"T_CARRAY_FLD": [bytearray(data), buffer(data, 1), memoryview(data)],
+                "T_LONG_FLD": len(data)}
+
+    def init(self, arguments):
+        try:
+                tpadvertise("CAREV", "CAREV")
+                tpadvertise("CAFLD", "CAFLD")
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 07_carray called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
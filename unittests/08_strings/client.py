@@ -0,0 +1,16 @@
+#!/usr/bin/python
+#
+# Client of the 08_strings server (test.py), exits with error on failure
+#
+import sys
+
+from endurox.atmi import *
+
+strs = ["", "a", "x" * 1000, "y" * 40000,
+        u"\u00e4\u00f6\u00fc".encode("utf-8"), "\xff\x01"]
+res = tpcall("STRLEN", {"T_STRING_FLD": strs})
+assert res["T_STRING_FLD"] == strs, [len(s) for s in res["T_STRING_FLD"]]
+assert res["T_LONG_FLD"] == [len(s) for s in strs], res["T_LONG_FLD"]
+
+tpterm()
+print "08_strings: OK"
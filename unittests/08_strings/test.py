@@ -0,0 +1,26 @@
+#!/usr/bin/python
+import sys
+
+from endurox.atmi import *
+
+class server:
+    def STRLEN(self, arg):
+        # string fields of any length, decoded without a bounce buffer
+        arg["T_LONG_FLD"] = [len(s) for s in arg["T_STRING_FLD"]]
+        return arg
+
+    def init(self, arguments):
+        try:
+                tpadvertise("STRLEN", "STRLEN")
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 08_strings called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
@@ -0,0 +1,27 @@
+#!/usr/bin/python
+#
+# Client of the 09_scalar server (test.py), exits with error on failure
+#
+import sys
+
+from endurox.atmi import *
+
+req = {"T_STRING_FLD": "one", "T_LONG_FLD": [1, 2, 3]}
+
+# default: every field is a list of occurrences
+res = tpcall("SCALAR", req)
+assert res["T_STRING_FLD"] == ["ONE"], res
+assert res["T_LONG_FLD"] == [1, 2, 3] * 200, res
+
+old = set_convflags(CONV_SCALAR)
+assert get_convflags() == CONV_SCALAR
+res = tpcall("SCALAR", req)
+set_convflags(old)
+assert res["T_STRING_FLD"] == "ONE", res
+assert res["T_LONG_FLD"] == [1, 2, 3] * 200, res
+
+# and the same for conversions on the client
+assert ubf_to_dict(req, convflags=CONV_SCALAR) == req
+
+tpterm()
+print "09_scalar: OK"
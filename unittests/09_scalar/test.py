@@ -0,0 +1,29 @@
+#!/usr/bin/python
+import sys
+
+from endurox.atmi import *
+
+class server:
+    def SCALAR(self, arg):
+        # single occurrences come as plain values
+        if arg["T_STRING_FLD"] != "one" or arg["T_LONG_FLD"] != [1, 2, 3]:
+                tplog(log_error, "SCALAR: bad request %s" % arg)
+                return TPFAIL
+        return {"T_STRING_FLD": arg["T_STRING_FLD"].upper(),
+                "T_LONG_FLD": arg["T_LONG_FLD"] * 200}
+
+    def init(self, arguments):
+        try:
+                tpadvertise("SCALAR", "SCALAR", CONV_SCALAR)
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 09_scalar called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
@@ -0,0 +1,16 @@
+#!/usr/bin/python
+#
+# Client of the 10_projection server (test.py), exits with error on failure
+#
+import sys
+
+from endurox.atmi import *
+
+req = {"T_STRING_FLD": ["abc", "def"], "T_CARRAY_FLD": "\x00\x01",
+       "T_LONG_FLD": [1, 2, 3], "T_SHORT_FLD": 7}
+res = tpcall("PROJ", req)
+assert res == {"T_STRING_FLD": ["abc", "def"], "T_CARRAY_FLD": ["\x00\x01"],
+               "T_LONG_FLD": [2, 4, 6]}, res
+
+tpterm()
+print "10_projection: OK"
@@ -0,0 +1,31 @@
+#!/usr/bin/python
+import sys
+
+from endurox.atmi import *
+
+class server:
+    def PROJ(self, arg):
+        # only the declared fields are decoded
+        if sorted(arg.keys()) != ["T_LONG_FLD", "T_SHORT_FLD"]:
+                tplog(log_error, "PROJ: got fields %s" % arg.keys())
+                return TPFAIL
+        # changes go back to the request buffer, the rest stays as is
+        arg["T_LONG_FLD"] = [v * 2 for v in arg["T_LONG_FLD"]]
+        del arg["T_SHORT_FLD"]
+        return arg
+
+    def init(self, arguments):
+        try:
+                tpadvertise("PROJ", "PROJ", fields=["T_LONG_FLD", "T_SHORT_FLD", "T_DOUBLE_FLD"])
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 10_projection called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
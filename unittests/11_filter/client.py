@@ -0,0 +1,41 @@
+#!/usr/bin/python
+#
+# Client of the 11_filter server (test.py), exits with error on failure
+#
+import sys
+
+from endurox.atmi import *
+
+assert tpcall("BIG", {"T_LONG_FLD": 500}) == {"T_STRING_FLD": ["big"]}
+assert tpcall("BIG", {"T_LONG_FLD": 5}) == {"T_STRING_FLD": ["small"]}
+assert tpcall("ONLYBIG", {"T_LONG_FLD": 500}) == {"T_STRING_FLD": ["big"]}
+try:
+    tpcall("ONLYBIG", {"T_LONG_FLD": 5})
+except RuntimeError:
+    pass
+else:
+    raise AssertionError("ONLYBIG: filter not applied")
+
+# expressions on the client side
+expr = BoolExpr("T_LONG_FLD > 100 && T_STRING_FLD == 'x'")
+assert expr is BoolExpr("T_LONG_FLD > 100 && T_STRING_FLD == 'x'")
+assert expr.text == "T_LONG_FLD > 100 && T_STRING_FLD == 'x'"
+assert expr.ev({"T_LONG_FLD": 200, "T_STRING_FLD": "x"})
+assert not expr.ev({"T_LONG_FLD": 200, "T_STRING_FLD": "y"})
+assert not expr.ev(UbfProxy({"T_LONG_FLD": 2, "T_STRING_FLD": "x"}))
+assert BoolExpr("T_LONG_FLD * 2").floatev({"T_LONG_FLD": 21}) == 42.0
+
+# the cache is bounded, objects in use stay valid
+for i in range(1000):
+    assert BoolExpr("T_LONG_FLD == %d" % i).ev({"T_LONG_FLD": i})
+assert expr.ev({"T_LONG_FLD": 200, "T_STRING_FLD": "x"})
+
+try:
+    BoolExpr("T_LONG_FLD >")
+except RuntimeError:
+    pass
+else:
+    raise AssertionError("bad expression compiled")
+
+tpterm()
+print "11_filter: OK"
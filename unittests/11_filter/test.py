@@ -0,0 +1,31 @@
+#!/usr/bin/python
+import sys
+
+from endurox.atmi import *
+
+class server:
+    def BIG(self, arg):
+        return {"T_STRING_FLD": "big"}
+
+    def SMALL(self, arg):
+        return {"T_STRING_FLD": "small"}
+
+    def init(self, arguments):
+        try:
+                # requests not matching go to SMALL without Python seeing them
+                tpadvertise("BIG", "BIG", filter="T_LONG_FLD > 100", filter_forward="SMALL")
+                tpadvertise("SMALL", "SMALL")
+                # ... or fail
+                tpadvertise("ONLYBIG", "BIG", filter=BoolExpr("T_LONG_FLD > 100"))
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 11_filter called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
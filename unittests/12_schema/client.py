@@ -0,0 +1,35 @@
+#!/usr/bin/python
+#
+# Client of the 12_schema server (test.py), exits with error on failure
+#
+import sys
+
+from endurox.atmi import *
+
+res = tpcall("REC", {"T_STRING_FLD": "abc", "T_LONG_FLD": [1, 2],
+                     "T_DOUBLE_FLD": 1.5})
+assert res == {"T_STRING_FLD": ["ABC"], "T_LONG_FLD": [1, 2, 3],
+               "T_SHORT_FLD": [9], "T_DOUBLE_FLD": [1.5]}, res
+
+assert tpcall("NEWREC", {"T_STRING_FLD": "x"}) == {"T_STRING_2_FLD": ["x"]}
+
+# records on the client
+schema = Schema([("T_LONG_FLD", True), "T_STRING_FLD"])
+assert schema.fields == ("T_LONG_FLD", "T_STRING_FLD")
+rec = schema.decode({"T_STRING_FLD": ["a", "b"], "T_DOUBLE_FLD": 1.0})
+assert rec.T_STRING_FLD == "a" and rec["T_STRING_FLD"] == "a"
+assert rec.T_LONG_FLD == []
+assert len(rec) == 2 and rec.keys() == ["T_LONG_FLD", "T_STRING_FLD"]
+rec.T_LONG_FLD = [5, 6]
+res = tpcall("NEWREC", rec)
+assert res == {"T_STRING_2_FLD": ["a"]}, res
+
+try:
+    rec.T_DOUBLE_FLD = 1.0
+except AttributeError:
+    pass
+else:
+    raise AssertionError("field outside of the schema set")
+
+tpterm()
+print "12_schema: OK"
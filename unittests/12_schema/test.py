@@ -0,0 +1,40 @@
+#!/usr/bin/python
+import sys
+
+from endurox.atmi import *
+
+class server:
+    def REC(self, arg):
+        # fields of the schema in slots, the rest stays in the buffer
+        if not isinstance(arg, Record) or arg.T_LONG_FLD != [1, 2] or arg.T_SHORT_FLD is not None:
+                tplog(log_error, "REC: bad request %s" % repr(arg))
+                return TPFAIL
+        arg.T_STRING_FLD = arg.T_STRING_FLD.upper()
+        arg.T_LONG_FLD.append(sum(arg.T_LONG_FLD))
+        arg.T_SHORT_FLD = 9
+        return arg
+
+    def NEWREC(self, arg):
+        # a record of another schema as reply
+        rec = self.out.decode({})
+        rec.T_STRING_2_FLD = arg["T_STRING_FLD"]
+        return rec
+
+    def init(self, arguments):
+        try:
+                schema = Schema(["T_STRING_FLD", ("T_LONG_FLD", True), "T_SHORT_FLD"])
+                self.out = Schema(["T_STRING_2_FLD"])
+                tpadvertise("REC", "REC", schema=schema)
+                tpadvertise("NEWREC", "NEWREC", schema=schema)
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 12_schema called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
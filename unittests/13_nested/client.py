@@ -0,0 +1,35 @@
+#!/usr/bin/python
+#
+# Client of the 13_nested server (test.py), exits with error on failure
+#
+import sys
+
+from endurox.atmi import *
+
+inner = {"T_STRING_FLD": ["inner"], "T_LONG_FLD": [1, 2]}
+view = {"vname": "UBTESTVIEW2", "data": {"tshort1": [5], "tlong1": [100000],
+                                         "tstring1": ["vstr"]}}
+
+res = tpcall("NEST", {"T_UBF_FLD": inner, "T_PTR_FLD": {"T_DOUBLE_FLD": 1.5},
+                      "T_VIEW_FLD": view})
+
+assert res["T_UBF_FLD"] == [inner, {"T_UBF_FLD": [inner]}], res["T_UBF_FLD"]
+assert res["T_PTR_FLD"] == [{"T_DOUBLE_FLD": [1.5]}, "string buffer",
+                            bytearray("\x00carray")], res["T_PTR_FLD"]
+assert res["T_STRING_FLD"] == ["innerUBTESTVIEW2"], res["T_STRING_FLD"]
+v = res["T_VIEW_FLD"][0]
+assert v["vname"] == "UBTESTVIEW2", v
+assert v["data"]["tshort1"] == [5] and v["data"]["tlong1"] == [100000], v
+assert v["data"]["tstring1"] == ["vstr"], v
+
+# nested proxies are copied in
+p = UbfProxy({"T_STRING_FLD": "p"})
+res = tpcall("NEST", {"T_UBF_FLD": p, "T_PTR_FLD": p, "T_VIEW_FLD": view})
+assert res["T_UBF_FLD"][0] == {"T_STRING_FLD": ["p"]}, res
+
+res = tpcall("WRAP", {"T_STRING_FLD": "abc"})
+assert res["T_UBF_FLD"] == [{"T_STRING_FLD": ["abc"]}], res
+assert res["T_PTR_FLD"] == [{"T_UBF_FLD": [{"T_STRING_FLD": ["abc"]}]}], res
+
+tpterm()
+print "13_nested: OK"
@@ -0,0 +1,36 @@
+#!/usr/bin/python
+import sys
+
+from endurox.atmi import *
+
+class server:
+    def NEST(self, arg):
+        # nested buffers come as their Python forms
+        inner = arg["T_UBF_FLD"][0]
+        ptr = arg["T_PTR_FLD"][0]
+        view = arg["T_VIEW_FLD"][0]
+        return {"T_UBF_FLD": [inner, {"T_UBF_FLD": inner}],
+                "T_PTR_FLD": [ptr, "string buffer", bytearray("\x00carray")],
+                "T_VIEW_FLD": view,
+                "T_STRING_FLD": inner["T_STRING_FLD"][0] + view["vname"]}
+
+    def WRAP(self, arg):
+        # flat request (test.ud) returned nested in UBF and PTR fields
+        return {"T_UBF_FLD": arg, "T_PTR_FLD": {"T_UBF_FLD": arg}}
+
+    def init(self, arguments):
+        try:
+                tpadvertise("NEST", "NEST")
+                tpadvertise("WRAP", "WRAP")
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 13_nested called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
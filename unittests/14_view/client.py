@@ -0,0 +1,35 @@
+#!/usr/bin/python
+#
+# Client of the 14_view server (test.py), exits with error on failure
+#
+import sys
+
+from endurox.atmi import *
+
+# same view many times: the field plan of the view is reused
+for i in range(100):
+    res = tpcall("VIEWINC", {"vname": "UBTESTVIEW2",
+                             "data": {"tshort1": [i], "tlong1": 1000 * i,
+                                      "tstring1": "abc%d" % i,
+                                      "tcarray1": bytearray("\x00\x01")}})
+    assert res["vname"] == "UBTESTVIEW2", res
+    data = res["data"]
+    assert data["tshort1"] == [i + 1], data
+    assert data["tlong1"] == [1000 * i + 1], data
+    assert data["tstring1"] == ["ABC%d" % i], data
+    assert data["tcarray1"][0][:2] == "\x00\x01", data
+
+res = tpcall("VIEWMK", {"T_SHORT_FLD": 7, "T_LONG_FLD": 70000, "T_STRING_FLD": "mk"})
+data = res["T_VIEW_FLD"][0]["data"]
+assert data["tshort1"] == [7] and data["tlong1"] == [70000], data
+assert data["tstring1"] == ["mk"], data
+
+try:
+    tpcall("VIEWINC", {"vname": "UBTESTVIEW2", "data": {"nosuchfield": [1]}})
+except KeyError:
+    pass
+else:
+    raise AssertionError("unknown view field accepted")
+
+tpterm()
+print "14_view: OK"
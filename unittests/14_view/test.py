@@ -0,0 +1,40 @@
+#!/usr/bin/python
+import sys
+
+from endurox.atmi import *
+
+class server:
+    def VIEWINC(self, arg):
+        # VIEW buffer as {"vname": ..., "data": {cname: occurrences}}
+        if arg["vname"] != "UBTESTVIEW2":
+                tplog(log_error, "VIEWINC: bad view %s" % arg["vname"])
+                return TPFAIL
+        data = arg["data"]
+        data["tshort1"] = [data["tshort1"][0] + 1]
+        data["tlong1"] = [data["tlong1"][0] + 1]
+        data["tstring1"] = [data["tstring1"][0].upper()]
+        return arg
+
+    def VIEWMK(self, arg):
+        # flat request (test.ud) returned as VIEW field
+        return {"T_VIEW_FLD": {"vname": "UBTESTVIEW2",
+                               "data": {"tshort1": arg["T_SHORT_FLD"],
+                                        "tlong1": arg["T_LONG_FLD"],
+                                        "tstring1": arg["T_STRING_FLD"]}}}
+
+    def init(self, arguments):
+        try:
+                tpadvertise("VIEWINC", "VIEWINC")
+                tpadvertise("VIEWMK", "VIEWMK")
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 14_view called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
@@ -0,0 +1,39 @@
+#!/usr/bin/python
+#
+# Client of the 15_json server (test.py), exits with error on failure
+#
+import sys
+import json
+
+from endurox.atmi import *
+
+doc = '{"T_STRING_FLD":"abc","T_LONG_FLD":[1,2]}'
+res = tpcall("JECHO", JsonStr(doc))
+assert isinstance(res, JsonStr) and json.loads(res) == json.loads(doc), res
+
+res = tpcall("JPARSE", JsonStr('{"items": [1, 2, 3]}'))
+assert json.loads(res) == {"items": [1, 2, 3], "count": 3}, res
+
+res = tpcall("J2UBF", JsonStr(doc))
+assert res == {"T_STRING_FLD": ["abc"], "T_LONG_FLD": [1, 2]}, res
+
+res = tpcall("JROUND", {"T_STRING_FLD": "abc", "T_LONG_FLD": [1, 2]})
+assert res == {"T_STRING_FLD": ["abc"], "T_LONG_FLD": [1, 2]}, res
+
+# conversions on the client; the large one outgrows the first buffer
+big = {"T_STRING_FLD": ["%04d" % i for i in range(3000)]}
+for d in ({"T_STRING_FLD": ["abc"], "T_LONG_FLD": [1, 2]}, big):
+    js = tpubftojson(d)
+    assert isinstance(js, JsonStr)
+    assert tpjsontoubf(js) == d
+assert tpjsontoubf('{"T_STRING_FLD":"x"}', CONV_SCALAR) == {"T_STRING_FLD": "x"}
+
+try:
+    tpjsontoubf('{"T_STRING_FLD": ')
+except RuntimeError:
+    pass
+else:
+    raise AssertionError("bad JSON converted")
+
+tpterm()
+print "15_json: OK"
@@ -0,0 +1,45 @@
+#!/usr/bin/python
+import sys
+import json
+
+from endurox.atmi import *
+
+class server:
+    def JECHO(self, arg):
+        # JSON buffer as atmi.JsonStr, returned as JSON again
+        if not isinstance(arg, JsonStr):
+                tplog(log_error, "JECHO: not a JsonStr: %s" % type(arg))
+                return TPFAIL
+        return arg
+
+    def JPARSE(self, arg):
+        # with CONV_JSON the document comes parsed
+        arg["count"] = len(arg["items"])
+        return JsonStr(json.dumps(arg))
+
+    def J2UBF(self, arg):
+        # JSON <-> UBF in C
+        return tpjsontoubf(arg)
+
+    def JROUND(self, arg):
+        # UBF request (test.ud) through JSON and back
+        return tpjsontoubf(tpubftojson(arg))
+
+    def init(self, arguments):
+        try:
+                tpadvertise("JECHO", "JECHO")
+                tpadvertise("JPARSE", "JPARSE", CONV_JSON)
+                tpadvertise("J2UBF", "J2UBF")
+                tpadvertise("JROUND", "JROUND")
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 15_json called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
@@ -0,0 +1,47 @@
+#!/usr/bin/python
+#
+# Client of the 16_array server (test.py), exits with error on failure
+#
+import sys
+from array import array
+
+from endurox.atmi import *
+
+longs = array("l", range(-500, 500))
+req = {"T_LONG_FLD": longs, "T_DOUBLE_FLD": [0.5, 1.0, 4.0],
+       "T_STRING_FLD": "abc"}
+
+# lists by default
+res = tpcall("SCALE", req)
+assert res["T_LONG_FLD"] == [v * 2 for v in longs], res
+assert res["T_DOUBLE_FLD"] == [0.25, 0.5, 2.0], res
+assert res["T_SHORT_FLD"] == [1000], res
+assert res["T_STRING_FLD"] == ["abc"], res
+
+# arrays on request, non-numeric fields stay lists
+old = set_convflags(CONV_ARRAY)
+res = tpcall("SCALE", req)
+set_convflags(old)
+assert res["T_LONG_FLD"] == array("l", [v * 2 for v in longs]), res
+assert res["T_DOUBLE_FLD"] == array("d", [0.25, 0.5, 2.0]), res
+assert res["T_SHORT_FLD"] == array("h", [1000]), res
+assert res["T_STRING_FLD"] == ["abc"], res
+
+# scalars and single values are no arrays
+res = tpcall("SCALE", {"T_LONG_FLD": 5, "T_DOUBLE_FLD": 1.0, "T_STRING_FLD": "x"})
+assert res["T_LONG_FLD"] == [10], res
+
+# arrays of other item types are converted to the field type
+res = tpcall("SCALE", {"T_LONG_FLD": array("h", [1, 2]),
+                       "T_DOUBLE_FLD": array("l", [3]), "T_STRING_FLD": "x"})
+assert res["T_LONG_FLD"] == [2, 4], res
+assert res["T_DOUBLE_FLD"] == [1.5], res
+
+# int items are widened to long (BFLD_INT is a VIEW only type)
+res = tpcall("SCALE", {"T_LONG_FLD": array("i", [-70000, 3]),
+                       "T_DOUBLE_FLD": array("i", [5]), "T_STRING_FLD": "x"})
+assert res["T_LONG_FLD"] == [-140000, 6], res
+assert res["T_DOUBLE_FLD"] == [2.5], res
+
+tpterm()
+print "16_array: OK"
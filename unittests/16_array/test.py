@@ -0,0 +1,34 @@
+#!/usr/bin/python
+import sys
+from array import array
+
+from endurox.atmi import *
+
+class server:
+    def SCALE(self, arg):
+        # numeric occurrences as array.array, written back in bulk
+        l = arg["T_LONG_FLD"]
+        d = arg["T_DOUBLE_FLD"]
+        if not isinstance(l, array) or l.typecode != "l" or d.typecode != "d":
+                tplog(log_error, "SCALE: not arrays: %s" % arg)
+                return TPFAIL
+        return {"T_LONG_FLD": array("l", [v * 2 for v in l]),
+                "T_DOUBLE_FLD": array("d", [v / 2 for v in d]),
+                "T_SHORT_FLD": array("h", [len(l)]),
+                "T_STRING_FLD": arg["T_STRING_FLD"]}
+
+    def init(self, arguments):
+        try:
+                tpadvertise("SCALE", "SCALE", CONV_ARRAY)
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 16_array called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
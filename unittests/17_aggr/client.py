@@ -0,0 +1,44 @@
+#!/usr/bin/python
+#
+# Client of the 17_aggr server (test.py), exits with error on failure
+#
+import sys
+
+from endurox.atmi import *
+
+res = tpcall("STATS", {"T_LONG_FLD": [4, 1, 2, 2, 11], "T_DOUBLE_FLD": [0.5, 0.25]})
+assert res == {"T_LONG_FLD": [20, 1, 11, 5, 4], "T_DOUBLE_FLD": [4.0, 0.75]}, res
+
+# on dicts, proxies and records on the client
+for d in ({"T_SHORT_FLD": [3, -3, 9]}, UbfProxy({"T_SHORT_FLD": [3, -3, 9]})):
+    assert ubf_sum(d, "T_SHORT_FLD") == 9
+    assert ubf_min(d, "T_SHORT_FLD") == -3
+    assert ubf_max(d, "T_SHORT_FLD") == 9
+    assert ubf_mean(d, "T_SHORT_FLD") == 3.0
+rec = Schema([("T_LONG_FLD", True)]).decode({"T_LONG_FLD": [1, 2]})
+assert ubf_sum(rec, "T_LONG_FLD") == 3
+
+# missing field
+assert ubf_sum({}, "T_LONG_FLD") == 0
+assert ubf_min({}, "T_LONG_FLD") is None
+assert ubf_mean({}, "T_LONG_FLD") is None
+assert ubf_count({}, "T_LONG_FLD") == 0
+
+# integer sums do not wrap around
+big = {"T_LONG_FLD": [sys.maxint, sys.maxint, 1]}
+assert ubf_sum(big, "T_LONG_FLD") == 2 * sys.maxint + 1
+assert ubf_mean(big, "T_LONG_FLD") == float(2 * sys.maxint + 1) / 3
+
+# strings and chars are counted, not summed
+assert ubf_count({"T_STRING_FLD": ["a", "b", "a"]}, "T_STRING_FLD") == 3
+assert ubf_distinct({"T_STRING_FLD": ["a", "b", "a"]}, "T_STRING_FLD") == 2
+for fld, val in (("T_STRING_FLD", "a"), ("T_CHAR_FLD", "a")):
+    try:
+        ubf_sum({fld: val}, fld)
+    except TypeError:
+        pass
+    else:
+        raise AssertionError("%s summed" % fld)
+
+tpterm()
+print "17_aggr: OK"
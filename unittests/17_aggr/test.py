@@ -0,0 +1,28 @@
+#!/usr/bin/python
+import sys
+
+from endurox.atmi import *
+
+class server:
+    def STATS(self, arg):
+        # reductions run on the request buffer, nothing is converted
+        return {"T_LONG_FLD": [ubf_sum(arg, "T_LONG_FLD"), ubf_min(arg, "T_LONG_FLD"),
+                               ubf_max(arg, "T_LONG_FLD"), ubf_count(arg, "T_LONG_FLD"),
+                               ubf_distinct(arg, "T_LONG_FLD")],
+                "T_DOUBLE_FLD": [ubf_mean(arg, "T_LONG_FLD"), ubf_sum(arg, "T_DOUBLE_FLD")]}
+
+    def init(self, arguments):
+        try:
+                tpadvertise("STATS", "STATS", CONV_PROXY)
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 17_aggr called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
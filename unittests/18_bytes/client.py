@@ -0,0 +1,46 @@
+#!/usr/bin/python
+#
+# Client of the 18_bytes server (test.py), exits with error on failure
+#
+import sys
+import pickle
+
+from endurox.atmi import *
+
+req = {"T_STRING_FLD": ["abc", ""], "T_LONG_FLD": [1, 2],
+       "T_CARRAY_FLD": ["\x00\xff"], "T_UBF_FLD": [{"T_DOUBLE_FLD": [0.5]}]}
+
+# serialized by the server, loaded back there and here
+data = tpcall("STORE", req)["T_CARRAY_FLD"][0]
+assert ubf_frombytes(data) == req
+assert ubf_frombytes(data, CONV_PROXY).todict() == req
+assert tpcall("LOAD", {"T_CARRAY_FLD": data}) == req
+assert ubf_tobytes(req) == data
+
+# proxies pickle as their binary form
+p = UbfProxy(req)
+for proto in (0, 2):
+    q = pickle.loads(pickle.dumps(p, proto))
+    assert isinstance(q, UbfProxy) and q == req, q
+
+# not a UBF buffer
+try:
+    ubf_frombytes("garbage")
+except RuntimeError:
+    pass
+else:
+    raise AssertionError("garbage loaded")
+
+# pointers have no meaning outside of the process
+try:
+    ubf_tobytes({"T_UBF_FLD": {"T_PTR_FLD": "x"}})
+except TypeError:
+    pass
+else:
+    raise AssertionError("PTR field serialized")
+
+for i in range(3):
+    assert tpcall("KEEP", {"T_LONG_FLD": i}) == {"T_SHORT_FLD": [1]}
+
+tpterm()
+print "18_bytes: OK"
@@ -0,0 +1,46 @@
+#!/usr/bin/python
+import sys
+import pickle
+
+from endurox.atmi import *
+
+class server:
+    def __init__(self):
+        self.kept = None
+
+    def STORE(self, arg):
+        # request in its binary form, e.g. for a cache
+        return {"T_CARRAY_FLD": ubf_tobytes(arg)}
+
+    def LOAD(self, arg):
+        return ubf_frombytes(arg["T_CARRAY_FLD"][0])
+
+    def KEEP(self, arg):
+        # proxy of the previous request has no buffer any more
+        ok = 1
+        if self.kept is not None:
+                try:
+                        pickle.dumps(self.kept, 2)
+                        ok = 0
+                except Exception:
+                        pass
+        self.kept = arg
+        return {"T_SHORT_FLD": ok}
+
+    def init(self, arguments):
+        try:
+                tpadvertise("STORE", "STORE", CONV_PROXY)
+                tpadvertise("LOAD", "LOAD")
+                tpadvertise("KEEP", "KEEP", CONV_PROXY)
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 18_bytes called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
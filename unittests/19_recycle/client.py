@@ -0,0 +1,35 @@
+#!/usr/bin/python
+#
+# Client of the 19_recycle server (test.py), exits with error on failure
+#
+import sys
+
+from endurox.atmi import *
+
+# requests of changing shape: stale fields must not survive
+for i in range(50):
+    req = {"T_LONG_FLD": range(i % 7)}
+    if i % 2:
+        req["T_STRING_FLD"] = "odd %d" % i
+    if not req["T_LONG_FLD"]:
+        del req["T_LONG_FLD"]
+    exp = dict((k, v if isinstance(v, list) else [v]) for k, v in req.items())
+    if "T_LONG_FLD" in exp:
+        exp["T_LONG_FLD"] = [v + 1 for v in exp["T_LONG_FLD"]]
+    res = tpcall("RECYCLE", req)
+    assert res == exp, (i, res, exp)
+
+# the same on the client: lists of the fields are reused
+d = {}
+ubf_to_dict({"T_LONG_FLD": [1, 2], "T_SHORT_FLD": 1}, into=d)
+l = d["T_LONG_FLD"]
+assert ubf_to_dict(UbfProxy({"T_LONG_FLD": [3]}), into=d) is d
+assert d == {"T_LONG_FLD": [3]} and d["T_LONG_FLD"] is l, d
+
+p = UbfProxy()
+assert dict_to_ubf({"T_STRING_FLD": "a" * 5000}, into=p) is p
+assert dict_to_ubf({"T_LONG_FLD": 1}, into=p) is p
+assert p == {"T_LONG_FLD": [1]}, p
+
+tpterm()
+print "19_recycle: OK"
@@ -0,0 +1,32 @@
+#!/usr/bin/python
+import sys
+
+from endurox.atmi import *
+
+class server:
+    def RECYCLE(self, arg):
+        # same dict and reply buffer for every request
+        d = ubf_to_dict(arg, into=self.req)
+        if d is not self.req:
+                return TPFAIL
+        if "T_LONG_FLD" in d:
+                d["T_LONG_FLD"] = [v + 1 for v in d["T_LONG_FLD"]]
+        return dict_to_ubf(d, into=self.rsp)
+
+    def init(self, arguments):
+        self.req = {}
+        self.rsp = UbfProxy()
+        try:
+                tpadvertise("RECYCLE", "RECYCLE", CONV_PROXY)
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 19_recycle called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
@@ -0,0 +1,22 @@
+#!/usr/bin/python
+#
+# Client of the 20_hotlog server (test.py), exits with error on failure
+#
+import sys
+
+from endurox.atmi import *
+
+req = {"T_STRING_FLD": ["a", "b"], "T_UBF_FLD": {"T_DOUBLE_FLD": 1.5}}
+
+# service and client keep working the same with logging off and on
+for on in (0, 1, 0, 1):
+    old = set_hotlog(on)
+    assert old == (not on), (on, old)
+    res = tpcall("LOGSW", dict(req, T_SHORT_FLD=on))
+    assert res["T_LONG_FLD"] == [int(not on)], res
+    assert res["T_STRING_FLD"] == ["a", "b"], res
+    assert res["T_UBF_FLD"] == [{"T_DOUBLE_FLD": [1.5]}], res
+    tplog(log_debug, "hotlog %d" % on)
+
+tpterm()
+print "20_hotlog: OK"
@@ -0,0 +1,27 @@
+#!/usr/bin/python
+import sys
+
+from endurox.atmi import *
+
+class server:
+    def LOGSW(self, arg):
+        # switch the conversion/dispatch logging for the next requests
+        old = set_hotlog(arg["T_SHORT_FLD"][0])
+        arg["T_LONG_FLD"] = int(old)
+        return arg
+
+    def init(self, arguments):
+        try:
+                tpadvertise("LOGSW", "LOGSW")
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 20_hotlog called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
@@ -0,0 +1,28 @@
+#!/usr/bin/python
+#
+# Client of the 21_rows server (test.py), exits with error on failure
+#
+import sys
+
+from endurox.atmi import *
+
+rows = [{"T_LONG_FLD": i, "T_STRING_FLD": "row %d" % i, "T_DOUBLE_FLD": i / 2.0}
+        for i in range(200)]
+
+res = tpcall("QUERY", {"T_LONG_FLD": 200})
+assert res["T_LONG_FLD"] == range(200), res
+assert ubf_to_rows(res) == rows
+
+assert ubf_to_rows(tpcall("QUERY", {"T_LONG_FLD": 0})) == []
+
+res = tpcall("TOTAL", rows_to_ubf(rows))
+assert res == {"T_DOUBLE_FLD": [sum(r["T_DOUBLE_FLD"] for r in rows)],
+               "T_LONG_FLD": [200]}, res
+
+# gaps are filled with the field defaults
+p = rows_to_ubf([{"T_LONG_FLD": 1}, {"T_STRING_FLD": "b"}, {"T_LONG_FLD": 3}])
+assert p["T_LONG_FLD"] == [1, 0, 3], p
+assert p["T_STRING_FLD"] == ["", "b"], p
+
+tpterm()
+print "21_rows: OK"
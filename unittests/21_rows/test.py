@@ -0,0 +1,34 @@
+#!/usr/bin/python
+import sys
+
+from endurox.atmi import *
+
+class server:
+    def QUERY(self, arg):
+        # result set of n rows, row i in occurrence i
+        n = arg["T_LONG_FLD"][0]
+        return rows_to_ubf([{"T_LONG_FLD": i, "T_STRING_FLD": "row %d" % i,
+                             "T_DOUBLE_FLD": i / 2.0} for i in range(n)])
+
+    def TOTAL(self, arg):
+        # rows of the request
+        rows = ubf_to_rows(arg)
+        return {"T_DOUBLE_FLD": sum(r["T_DOUBLE_FLD"] for r in rows),
+                "T_LONG_FLD": len(rows)}
+
+    def init(self, arguments):
+        try:
+                tpadvertise("QUERY", "QUERY")
+                tpadvertise("TOTAL", "TOTAL", CONV_PROXY)
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 21_rows called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
@@ -0,0 +1,34 @@
+#!/usr/bin/python
+#
+# Client of the 22_nogil server (test.py), exits with error on failure
+#
+import sys
+import time
+import threading
+
+from endurox.atmi import *
+
+result = []
+
+def caller():
+    # own ATMI context in this thread
+    result.append(tpcall("SLOW", {"T_DOUBLE_FLD": 1.0}))
+    tpterm()
+
+# Python code keeps running while the call waits for the reply
+t = threading.Thread(target=caller)
+start = time.time()
+t.start()
+spins = 0
+while t.isAlive():
+    spins += 1
+elapsed = time.time() - start
+t.join()
+
+assert result == [{"T_DOUBLE_FLD": [1.0]}], result
+assert elapsed >= 1.0, elapsed
+# with the GIL held over tpcall() the loop would barely run
+assert spins > 100000, spins
+
+tpterm()
+print "22_nogil: OK (%d spins in %.2fs)" % (spins, elapsed)
@@ -0,0 +1,26 @@
+#!/usr/bin/python
+import sys
+import time
+
+from endurox.atmi import *
+
+class server:
+    def SLOW(self, arg):
+        time.sleep(arg["T_DOUBLE_FLD"][0])
+        return arg
+
+    def init(self, arguments):
+        try:
+                tpadvertise("SLOW", "SLOW")
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 22_nogil called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
@@ -0,0 +1,49 @@
+#!/usr/bin/python
+#
+# Client of the 23_aio server (test.py), exits with error on failure
+#
+import sys
+import select
+
+from endurox.atmi import *
+import endurox.aio
+
+client = endurox.aio.Client(max_workers=4)
+
+futures = [client.acall("ECHO", {"T_LONG_FLD": i}) for i in range(200)]
+for i, f in enumerate(futures):
+    assert f.result(timeout=10) == {"T_LONG_FLD": [i]}, (i, f.result())
+
+# failures go to the future of the call
+f = client.acall("FAIL", {"T_LONG_FLD": 1})
+e = f.exception(timeout=10)
+assert isinstance(e, endurox.aio.CallError), e
+assert e.tperrno == TPESVCFAIL and e.tpurcode == 7, (e.tperrno, e.tpurcode)
+e = client.acall("NOSUCHSVC", {}).exception(timeout=10)
+assert e is not None
+
+# one-way calls are done at once
+assert client.acall("ECHO", {"T_LONG_FLD": 1}, TPNOREPLY).result(timeout=10) is None
+
+# callbacks and event loop integration
+called = []
+fd = client.fileno()
+futures = [client.acall("ECHO", {"T_LONG_FLD": i}) for i in range(20)]
+futures[0].add_done_callback(called.append)
+done = []
+while len(done) < len(futures):
+    r, w, x = select.select([fd], [], [], 10)
+    assert r, "no completion in 10s"
+    done.extend(client.completed())
+assert sorted(id(f) for f in done) == sorted(id(f) for f in futures)
+assert called == [futures[0]], called
+
+client.close()
+try:
+    client.acall("ECHO", {})
+except RuntimeError:
+    pass
+else:
+    raise AssertionError("call on closed client")
+
+print "23_aio: OK"
@@ -0,0 +1,29 @@
+#!/usr/bin/python
+import sys
+
+from endurox.atmi import *
+
+class server:
+    def ECHO(self, arg):
+        return arg
+
+    def FAIL(self, arg):
+        set_tpurcode(7)
+        return TPFAIL
+
+    def init(self, arguments):
+        try:
+                tpadvertise("ECHO", "ECHO")
+                tpadvertise("FAIL", "FAIL")
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 23_aio called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
@@ -0,0 +1,49 @@
+#!/usr/bin/python
+#
+# Client of the 24_fanout server (test.py), exits with error on failure
+#
+import sys
+import time
+
+from endurox.atmi import *
+
+# results in call order, failures reported per call
+calls = [("ECHO", {"T_LONG_FLD": i}) for i in range(50)]
+calls.append(("NOSUCHSVC", {"T_LONG_FLD": 1}))
+calls.append(("ECHO", "string", 0))
+res = tpcall_many(calls)
+assert len(res) == len(calls)
+for i in range(50):
+    assert res[i] == (0, 0, {"T_LONG_FLD": [i]}), res[i]
+assert res[50][0] == TPENOENT and res[50][2] is None, res[50]
+assert res[51] == (0, 0, "string"), res[51]
+
+# tpcall() raises on a service failure, here it is reported in place
+err, urcode, data = tpcall_many([("FAIL", {"T_LONG_FLD": 1})])[0]
+assert err == TPESVCFAIL and urcode == 3, (err, urcode)
+
+# the deadline covers the whole fan-out
+start = time.time()
+res = tpcall_many([("ECHO", {"T_LONG_FLD": 1}), ("SLOW", {"T_LONG_FLD": 2})], timeout=1)
+elapsed = time.time() - start
+assert res[0] == (0, 0, {"T_LONG_FLD": [1]}), res[0]
+assert res[1][0] == TPETIME, res[1]
+assert elapsed < 2.5, elapsed
+
+# calls with TPNOTIME are not cut off by the deadline
+start = time.time()
+res = tpcall_many([("SLOW", {"T_LONG_FLD": 4}, TPNOTIME), ("SLOW", {"T_LONG_FLD": 5})], timeout=1)
+elapsed = time.time() - start
+assert res[0] == (0, 0, {"T_LONG_FLD": [4]}), res[0]
+assert res[1][0] == TPETIME, res[1]
+assert elapsed >= 2.5, elapsed
+
+# the late reply of the cancelled call does not get mixed in
+time.sleep(3)
+res = tpcall_many([("ECHO", {"T_LONG_FLD": 3})])
+assert res == [(0, 0, {"T_LONG_FLD": [3]})], res
+
+assert tpcall_many([]) == []
+
+tpterm()
+print "24_fanout: OK"
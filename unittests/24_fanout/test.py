@@ -0,0 +1,35 @@
+#!/usr/bin/python
+import sys
+import time
+
+from endurox.atmi import *
+
+class server:
+    def ECHO(self, arg):
+        return arg
+
+    def FAIL(self, arg):
+        set_tpurcode(3)
+        return TPFAIL
+
+    def SLOW(self, arg):
+        time.sleep(3)
+        return arg
+
+    def init(self, arguments):
+        try:
+                tpadvertise("ECHO", "ECHO")
+                tpadvertise("FAIL", "FAIL")
+                tpadvertise("SLOW", "SLOW")
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 24_fanout called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
@@ -0,0 +1,63 @@
+#!/usr/bin/python
+#
+# Client of the 25_prepared server (test.py), exits with error on failure
+#
+import sys
+
+from endurox.atmi import *
+
+echo = PreparedCall("ECHO")
+assert echo.service == "ECHO" and echo.flags == 0 and echo.buftype == "UBF"
+
+# buffers are reused, fields of the previous request must not stay
+for i in range(500):
+    req = {"T_LONG_FLD": i}
+    if i % 3 == 0:
+        req["T_STRING_FLD"] = "x" * (i * 10)
+    exp = dict((k, [v]) for k, v in req.items())
+    assert echo(req) == exp, i
+    assert echo.call(req) == exp, i
+
+# other request forms
+assert echo(UbfProxy({"T_LONG_FLD": 1})) == {"T_LONG_FLD": [1]}
+rec = Schema(["T_LONG_FLD"]).decode({"T_LONG_FLD": 2})
+assert echo(rec) == {"T_LONG_FLD": [2]}
+
+# string buffers, growing past the size hint
+up = PreparedCall("TOUPPER", buftype="STRING", size_hint=16)
+for s in ("abc", "x" * 20000, "def"):
+    assert up(s) == s.upper()
+
+# reply as proxy does not take the prepared reply buffer away
+old = set_convflags(CONV_PROXY)
+p1 = echo({"T_LONG_FLD": 1})
+p2 = echo({"T_LONG_FLD": 2})
+set_convflags(old)
+assert p1 == {"T_LONG_FLD": [1]} and p2 == {"T_LONG_FLD": [2]}, (p1, p2)
+
+for args, exc in ((("X" * 100,), RuntimeError),
+                  (("ECHO", 0, "XML"), ValueError),
+                  (("ECHO", -1), ValueError)):
+    try:
+        PreparedCall(*args)
+    except exc:
+        pass
+    else:
+        raise AssertionError("PreparedCall%s accepted" % (args,))
+
+try:
+    up({"T_LONG_FLD": 1})
+except TypeError:
+    pass
+else:
+    raise AssertionError("dict sent in STRING buffer")
+
+try:
+    PreparedCall("NOSUCHSVC")({})
+except RuntimeError:
+    pass
+else:
+    raise AssertionError("call to missing service")
+
+tpterm()
+print "25_prepared: OK"
@@ -0,0 +1,28 @@
+#!/usr/bin/python
+import sys
+
+from endurox.atmi import *
+
+class server:
+    def ECHO(self, arg):
+        return arg
+
+    def TOUPPER(self, arg):
+        return arg.upper()
+
+    def init(self, arguments):
+        try:
+                tpadvertise("ECHO", "ECHO")
+                tpadvertise("TOUPPER", "TOUPPER")
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 25_prepared called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end
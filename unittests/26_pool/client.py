@@ -0,0 +1,38 @@
+#!/usr/bin/python
+#
+# Client of the 26_pool server (test.py), exits with error on failure
+#
+import sys
+
+from endurox.atmi import *
+
+# reply sizes jumping around the estimate, the pooled receive buffers
+# must never leak data of a previous reply
+sizes = [10, 30000, 10, 50000, 100, 0, 2000] * 10
+for n in sizes:
+    cd = tpacall("SIZED", {"T_LONG_FLD": n})
+    res = tpgetrply(cd)
+    assert res == {"T_STRING_FLD": ["x" * n]}, (n, len(res["T_STRING_FLD"][0]))
+
+    cd = tpacall("STR", {"T_LONG_FLD": n})
+    assert tpgetrply(cd) == "s" * n, n
+
+# several outstanding calls, taken in any order
+cds = {}
+for n in sizes[:7]:
+    cds[tpacall("SIZED", {"T_LONG_FLD": n})] = n
+while cds:
+    cd, data, err, urcode = tpgetrplyex()
+    n = cds.pop(cd)
+    assert err == 0 and data == {"T_STRING_FLD": ["x" * n]}, (cd, n, err)
+
+for n in sizes[:7]:
+    tpacall("SIZED", {"T_LONG_FLD": n})
+got = sorted(len(tpgetrply(0)["T_STRING_FLD"][0]) for n in sizes[:7])
+assert got == sorted(sizes[:7]), got
+
+# nothing outstanding
+assert tpgetrplyex(TPNOBLOCK) is None
+
+tpterm()
+print "26_pool: OK"
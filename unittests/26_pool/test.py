@@ -0,0 +1,30 @@
+#!/usr/bin/python
+import sys
+
+from endurox.atmi import *
+
+class server:
+    def SIZED(self, arg):
+        # reply of the size asked for
+        return {"T_STRING_FLD": "x" * arg["T_LONG_FLD"][0]}
+
+    def STR(self, arg):
+        # reply of another buffer type
+        return "s" * arg["T_LONG_FLD"][0]
+
+    def init(self, arguments):
+        try:
+                tpadvertise("SIZED", "SIZED")
+                tpadvertise("STR", "STR")
+        except Exception as e:
+                print str(e)
+
+    def cleanup(self):
+        userlog("cleanup in 26_pool called!")
+
+srv = server()
+
+if __name__ == '__main__': 
+    mainloop(sys.argv, srv, None)
+
+# end